@@ -0,0 +1,295 @@
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <asio.hpp>
+#include <rawmode.h>
+#include <termcap_entry.h>
+#include <termgrid.h>
+#include <backend.h>
+#include <file_lines.h>
+
+using DispatchFunc = std::function<bool(int c)>;
+
+#include "../../_external/wcwidth-cjk/wcwidth.c"
+
+class Asio
+{
+    asio::io_context context;
+    asio::posix::stream_descriptor tty;
+    char byteArray[1];
+    asio::signal_set signals;
+    asio::steady_timer timer;
+
+    termgrid::RawMode rawmode;
+    termgrid::TermcapEntryPtr m_entry;
+
+public:
+    Asio(int tty)
+        : rawmode(tty), tty(context, tty),
+          signals(context, SIGINT, SIGTERM, SIGWINCH), timer(context)
+    {
+    }
+
+    ~Asio()
+    {
+    }
+
+    void Quit()
+    {
+        signals.cancel();
+        timer.cancel();
+    }
+
+    // call callback every interval while it returns true
+    void Every(std::chrono::milliseconds interval,
+               const std::function<bool()> &callback)
+    {
+        timer.expires_after(interval);
+        timer.async_wait([this, interval, callback](const asio::error_code &ec) {
+            if (!ec && callback())
+            {
+                Every(interval, callback);
+            }
+        });
+    }
+
+    void ReadTty(const DispatchFunc &dispatcher)
+    {
+        auto buffer = asio::buffer(byteArray);
+        auto callback = std::bind(&Asio::OnReadTty, this, dispatcher,
+                                  std::placeholders::_1, std::placeholders::_2);
+        tty.async_read_some(buffer, callback);
+    }
+
+    void OnReadTty(const DispatchFunc &dispatcher, asio::error_code ec,
+                   std::size_t n)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        // getch
+        auto c = byteArray[0];
+        if (!dispatcher(c))
+        {
+            Quit();
+            return;
+        }
+
+        // next read
+        ReadTty(dispatcher);
+    }
+
+    void OnSignal(const asio::error_code &error, int signal)
+    {
+        std::cout << "signal: " << signal << std::endl;
+    }
+
+    void Signal()
+    {
+        auto callback = std::bind(&Asio::OnSignal, this, std::placeholders::_1,
+                                  std::placeholders::_2);
+        signals.async_wait(callback);
+    }
+
+    void Run()
+    {
+        context.run();
+    }
+};
+
+class FileView
+{
+    termgrid::TermcapEntryPtr m_entry;
+    termgrid::AnyBackend m_backend;
+    termgrid::FileLineSourcePtr m_source;
+
+    // term size
+    int m_cols = 0;
+    int m_lines = 0;
+
+    // m_tail == false: index of top line
+    // m_tail == true: index from end of top line. until index complete
+    int64_t m_top = 0;
+    bool m_tail = false;
+
+    std::string m_frame;
+
+public:
+    FileView(const termgrid::TermcapEntryPtr &entry,
+             const termgrid::AnyBackend &backend,
+             const termgrid::FileLineSourcePtr &source)
+        : m_entry(entry), m_backend(backend), m_source(source)
+    {
+        m_cols = m_entry->columns();
+        m_lines = m_entry->lines();
+        Draw();
+    }
+
+    ~FileView()
+    {
+        // move
+        m_entry->cursor_xy(0, m_lines - 1);
+        std::cout.flush();
+    }
+
+    void Draw()
+    {
+        auto height = m_lines - 1;
+        if (m_tail && m_source->IsIndexComplete())
+        {
+            // switch to absolute index
+            m_top = std::max<int64_t>(0, m_source->IndexedLines() - 1 - m_top);
+            m_tail = false;
+        }
+
+        m_entry->cursor_show(false);
+        m_frame.clear();
+        termgrid::RenderBlit(
+            m_frame, m_backend,
+            [this](const termgrid::TermPoint &p) {
+                return m_tail ? m_source->GetTailLine(m_top - p.y)
+                              : m_source->GetLine(m_top + p.y);
+            },
+            {0, 0}, {m_cols, height}, {0, 0});
+        std::cout.write(m_frame.data(), m_frame.size());
+
+        {
+            m_entry->cursor_xy(0, m_lines - 1);
+            m_entry->standout(true);
+            if (m_tail)
+            {
+                std::cout << "END-" << m_top;
+            }
+            else
+            {
+                std::cout << "line " << m_top + 1;
+            }
+            std::cout << " / " << m_source->IndexedLines();
+            if (!m_source->IsIndexComplete())
+            {
+                std::cout << " (indexing...)";
+            }
+            m_entry->clear_to_eol();
+            m_entry->standout(false);
+        }
+
+        std::cout.flush();
+    }
+
+    // redraw the index progress. false when the index is complete
+    bool OnIndexProgress()
+    {
+        Draw();
+        return !m_source->IsIndexComplete();
+    }
+
+    bool Dispatch(int c)
+    {
+        if (c == 'q' || c == 0x1b)
+        {
+            return false;
+        }
+
+        m_cols = m_entry->columns();
+        m_lines = m_entry->lines();
+        auto height = m_lines - 1;
+        // scroll toward end
+        int64_t d = 0;
+        switch (c)
+        {
+        case 'j':
+            d = 1;
+            break;
+
+        case 'k':
+            d = -1;
+            break;
+
+        case ' ':
+            d = height;
+            break;
+
+        case 'b':
+            d = -height;
+            break;
+
+        case 'g':
+            m_tail = false;
+            m_top = 0;
+            break;
+
+        case 'G':
+            if (m_source->IsIndexComplete())
+            {
+                m_tail = false;
+                m_top = m_source->IndexedLines() - height;
+            }
+            else
+            {
+                m_tail = true;
+                m_top = height - 1;
+            }
+            break;
+        }
+
+        if (m_tail)
+        {
+            m_top = std::max<int64_t>(m_top - d, height - 1);
+            // not above the first line
+            m_top = std::max<int64_t>(0, m_source->TailLines(m_top + 1) - 1);
+        }
+        else
+        {
+            m_top = std::clamp<int64_t>(
+                m_top + d, 0,
+                std::max<int64_t>(0, m_source->IndexedLines() - height));
+        }
+
+        Draw();
+
+        return true;
+    }
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " FILE" << std::endl;
+        return 1;
+    }
+
+    auto entry = termgrid::TermcapEntry::create_from_env();
+    if (!entry)
+    {
+        return 1;
+    }
+
+    auto source = termgrid::FileLineSource::open(argv[1], wcwidth_cjk);
+    if (!source)
+    {
+        std::cerr << "fail to open: " << argv[1] << std::endl;
+        return 2;
+    }
+
+    // escape sequences are compiled in for known terminals
+    auto backend = termgrid::DetectBackend(getenv("TERM"), entry);
+
+    // main loop
+    Asio asio(0);
+    {
+        FileView d(entry, backend, source);
+        asio.ReadTty([&d](int c) { return d.Dispatch(c); });
+        if (!source->IsIndexComplete())
+        {
+            asio.Every(std::chrono::milliseconds(200),
+                       [&d]() { return d.OnIndexProgress(); });
+        }
+        asio.Signal();
+        asio.Run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <chrono>
+#include <fmt/core.h>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <vector>
+#include <pty_pane.h>
+
+// key_latency [-n KEYS] [-r RATE] [-p BYTES] [-k SEQ] [-q QUIT] -- COMMAND [ARGS...]
+//
+// COMMAND を 80x24 の pty で動かし、key を書いてから出力が届くまでの時間を測る。
+// single: 1 key 書いて出力が止まるまで待つ。を KEYS 回
+// burst:  RATE key/s で待たずに KEYS 個書く (auto-repeat)
+// paste:  BYTES の bracketed paste を PASTES 回
+//
+// first は key から最初の出力 byte まで、frame は出力が止まる直前の byte まで。
+// burst の first は key の後に最初に届いた出力までで、どの key の frame かは問わない。
+// SEQ は書く key の列で、順に繰り返す。QUIT は最後に書いて終了させる key
+#include "../../_external/wcwidth-cjk/wcwidth.c"
+
+using Clock = std::chrono::steady_clock;
+
+// output stopped for this long is the end of a frame
+static const auto QUIET = std::chrono::milliseconds(50);
+// no output for this long is a dropped key
+static const auto TIMEOUT = std::chrono::seconds(2);
+static const int PASTES = 10;
+
+static double to_ms(Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+struct Stats
+{
+    size_t count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+static Stats get_stats(std::vector<double> values)
+{
+    Stats s;
+    s.count = values.size();
+    if (values.empty())
+    {
+        return s;
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&values](double q) {
+        return values[std::min(values.size() - 1, (size_t)(values.size() * q))];
+    };
+    s.p50 = at(0.5);
+    s.p99 = at(0.99);
+    s.max = values.back();
+    return s;
+}
+
+static void print_stats(const char *name, const Stats &s)
+{
+    fmt::print("  {:<6} p50 {:8.3f}  p99 {:8.3f}  max {:8.3f} ms  ({})\n", name,
+               s.p50, s.p99, s.max, s.count);
+}
+
+class Harness
+{
+    termgrid::PtyPane m_pty;
+    bool m_eof = false;
+
+public:
+    struct Output
+    {
+        std::optional<Clock::time_point> first;
+        Clock::time_point last;
+        uint64_t bytes = 0;
+    };
+
+    Harness() : m_pty({80, 24}, wcwidth_cjk)
+    {
+    }
+
+    bool Spawn(const std::vector<std::string> &argv)
+    {
+        return m_pty.Spawn(argv);
+    }
+
+    bool IsEof() const
+    {
+        return m_eof;
+    }
+
+    // the rest is written while reading
+    void Write(std::string_view input)
+    {
+        m_pty.Write(input);
+    }
+
+    /// deadline まで出力を待つ。届いたら読めるだけ読んで到着時刻を返す
+    std::optional<Clock::time_point> Poll(Clock::time_point deadline,
+                                          uint64_t *bytes)
+    {
+        if (m_eof)
+        {
+            return {};
+        }
+        auto timeout =
+            std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+        pollfd p = {m_pty.fd(), POLLIN, 0};
+        if (poll(&p, 1, std::max<int>(0, timeout.count())) <= 0)
+        {
+            return {};
+        }
+        return Receive(bytes);
+    }
+
+    /// input を書き切るまで、書けない間は出力を読む。
+    /// 子が出力で止まっていると pty の入力も空かないので、読まずに待つと両方止まる
+    template <typename F>
+    void WriteReading(std::string_view input, const F &onOutput)
+    {
+        auto deadline = Clock::now() + TIMEOUT;
+        m_pty.Write(input);
+        while (m_pty.HasPendingInput() && !m_eof && Clock::now() < deadline)
+        {
+            if (m_pty.FlushInput())
+            {
+                break;
+            }
+            pollfd p = {m_pty.fd(), POLLIN | POLLOUT, 0};
+            if (poll(&p, 1, (int)QUIET.count()) <= 0 || !(p.revents & ~POLLOUT))
+            {
+                continue;
+            }
+            uint64_t bytes;
+            if (auto t = Receive(&bytes))
+            {
+                onOutput(*t, bytes);
+                deadline = Clock::now() + TIMEOUT;
+            }
+        }
+    }
+
+    /// 出力が QUIET の間止まるまで読む
+    Output WaitQuiet(Clock::time_point since)
+    {
+        Output out;
+        auto deadline = since + TIMEOUT;
+        while (!m_eof)
+        {
+            auto limit =
+                out.first ? std::min(out.last + QUIET, deadline) : deadline;
+            if (Clock::now() >= limit)
+            {
+                break;
+            }
+            uint64_t bytes;
+            if (auto t = Poll(limit, &bytes))
+            {
+                if (!out.first)
+                {
+                    out.first = t;
+                }
+                out.last = *t;
+                out.bytes += bytes;
+            }
+        }
+        return out;
+    }
+
+    int Close()
+    {
+        return m_pty.Close();
+    }
+
+private:
+    // fd is readable
+    std::optional<Clock::time_point> Receive(uint64_t *bytes)
+    {
+        auto now = Clock::now();
+        auto before = m_pty.received();
+        if (!m_pty.Read())
+        {
+            m_eof = true;
+        }
+        *bytes = m_pty.received() - before;
+        if (!*bytes)
+        {
+            return {};
+        }
+        return now;
+    }
+};
+
+static void run_single(Harness &h, const std::string &seq, int keys)
+{
+    std::vector<double> first;
+    std::vector<double> frame;
+    uint64_t bytes = 0;
+    int dropped = 0;
+    for (int i = 0; i < keys && !h.IsEof(); ++i)
+    {
+        auto sent = Clock::now();
+        h.Write(seq.substr(i % seq.size(), 1));
+        auto out = h.WaitQuiet(sent);
+        if (!out.first)
+        {
+            ++dropped;
+            continue;
+        }
+        first.push_back(to_ms(*out.first - sent));
+        frame.push_back(to_ms(out.last - sent));
+        bytes += out.bytes;
+    }
+
+    fmt::print("single: {} keys, {} without output, {:.0f} bytes/key\n", keys,
+               dropped, keys ? (double)bytes / keys : 0.0);
+    print_stats("first", get_stats(first));
+    print_stats("frame", get_stats(frame));
+}
+
+static void run_burst(Harness &h, const std::string &seq, int keys, int rate)
+{
+    auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / rate));
+    std::vector<Clock::time_point> sent;
+    std::vector<double> first;
+    uint64_t bytes = 0;
+    // sent[answered..] have no output after them yet
+    size_t answered = 0;
+    auto onOutput = [&](Clock::time_point t, uint64_t n) {
+        for (; answered < sent.size(); ++answered)
+        {
+            first.push_back(to_ms(t - sent[answered]));
+        }
+        bytes += n;
+    };
+
+    auto next = Clock::now();
+    for (int i = 0; i < keys && !h.IsEof(); ++i)
+    {
+        while (Clock::now() < next && !h.IsEof())
+        {
+            uint64_t n;
+            if (auto t = h.Poll(next, &n))
+            {
+                onOutput(*t, n);
+            }
+        }
+        sent.push_back(Clock::now());
+        h.WriteReading(seq.substr(i % seq.size(), 1), onOutput);
+        next += interval;
+    }
+    auto out = h.WaitQuiet(sent.empty() ? Clock::now() : sent.back());
+    if (out.first)
+    {
+        onOutput(*out.first, out.bytes);
+    }
+
+    fmt::print("burst: {} keys at {}/s, {} without output, {:.0f} bytes/key\n",
+               keys, rate, sent.size() - answered,
+               keys ? (double)bytes / keys : 0.0);
+    print_stats("first", get_stats(first));
+    if (out.first && !sent.empty())
+    {
+        // catch up after the last key
+        fmt::print("  tail   {:8.3f} ms\n", to_ms(out.last - sent.back()));
+    }
+}
+
+static void run_paste(Harness &h, size_t size)
+{
+    std::string text;
+    for (size_t i = 0; i < size; ++i)
+    {
+        text.push_back(i % 80 == 79 ? '\r' : 'a' + i % 26);
+    }
+
+    std::vector<double> first;
+    std::vector<double> frame;
+    uint64_t bytes = 0;
+    for (int i = 0; i < PASTES && !h.IsEof(); ++i)
+    {
+        Harness::Output out;
+        auto sent = Clock::now();
+        auto onOutput = [&out](Clock::time_point t, uint64_t n) {
+            if (!out.first)
+            {
+                out.first = t;
+            }
+            out.last = t;
+            out.bytes += n;
+        };
+        h.WriteReading("\033[200~", onOutput);
+        h.WriteReading(text, onOutput);
+        h.WriteReading("\033[201~", onOutput);
+        auto rest = h.WaitQuiet(Clock::now());
+        if (rest.first)
+        {
+            onOutput(*rest.first, rest.bytes);
+            out.last = rest.last;
+        }
+        if (!out.first)
+        {
+            continue;
+        }
+        first.push_back(to_ms(*out.first - sent));
+        frame.push_back(to_ms(out.last - sent));
+        bytes += out.bytes;
+    }
+
+    fmt::print("paste: {} x {} bytes, {:.0f} bytes/paste\n", PASTES, size,
+               first.empty() ? 0.0 : (double)bytes / first.size());
+    print_stats("first", get_stats(first));
+    print_stats("frame", get_stats(frame));
+}
+
+int main(int argc, char **argv)
+{
+    int keys = 100;
+    int rate = 30;
+    size_t paste = 16 * 1024;
+    std::string seq = "jjjjkkkk";
+    std::string quit = "q";
+    std::vector<std::string> command;
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string_view(argv[i]);
+        if (arg == "--")
+        {
+            command.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        if (i + 1 >= argc)
+        {
+            break;
+        }
+        if (arg == "-n")
+        {
+            keys = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "-r")
+        {
+            rate = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "-p")
+        {
+            paste = atoi(argv[++i]);
+        }
+        else if (arg == "-k")
+        {
+            seq = argv[++i];
+        }
+        else if (arg == "-q")
+        {
+            quit = argv[++i];
+        }
+    }
+    if (command.empty() || seq.empty())
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [-n KEYS] [-r RATE] [-p BYTES] [-k SEQ] [-q QUIT] -- "
+                     "COMMAND [ARGS...]"
+                  << std::endl;
+        return 1;
+    }
+
+    Harness h;
+    if (!h.Spawn(command))
+    {
+        std::cerr << "fail to spawn: " << command[0] << std::endl;
+        return 2;
+    }
+
+    // first frame
+    auto start = Clock::now();
+    auto out = h.WaitQuiet(start);
+    if (!out.first)
+    {
+        std::cerr << "no output from: " << command[0] << std::endl;
+        h.Close();
+        return 3;
+    }
+    fmt::print("startup: {:.3f} ms, {} bytes\n", to_ms(out.last - start),
+               out.bytes);
+
+    run_single(h, seq, keys);
+    run_burst(h, seq, keys, rate);
+    if (paste)
+    {
+        run_paste(h, paste);
+    }
+    if (h.IsEof())
+    {
+        std::cerr << command[0] << " exited during the run" << std::endl;
+    }
+
+    h.Write(quit);
+    h.WaitQuiet(Clock::now());
+    h.Close();
+    return 0;
+}
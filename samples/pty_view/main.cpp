@@ -0,0 +1,597 @@
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <asio.hpp>
+#include <rawmode.h>
+#include <termcap_entry.h>
+#include <termgrid.h>
+#include <backend.h>
+#include <pty_pane.h>
+#include <line_cache.h>
+#include <scrollback.h>
+#include <reflow.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using DispatchFunc = std::function<bool(std::string_view data)>;
+
+#include "../../_external/wcwidth-cjk/wcwidth.c"
+
+class Asio
+{
+    asio::io_context context;
+    asio::posix::stream_descriptor tty;
+    char byteArray[4096];
+    asio::signal_set signals;
+
+    termgrid::RawMode rawmode;
+
+    std::unique_ptr<asio::posix::stream_descriptor> m_pty;
+    bool m_waitingWrite = false;
+    bool m_idle = false;
+
+public:
+    Asio(int tty)
+        : rawmode(tty), tty(context, tty),
+          signals(context, SIGINT, SIGTERM, SIGWINCH)
+    {
+    }
+
+    ~Asio()
+    {
+    }
+
+    void Quit()
+    {
+        signals.cancel();
+        // the child may exit while waiting a key
+        tty.cancel();
+        m_pty.reset();
+    }
+
+    void ReadTty(const DispatchFunc &dispatcher)
+    {
+        auto buffer = asio::buffer(byteArray);
+        auto callback = std::bind(&Asio::OnReadTty, this, dispatcher,
+                                  std::placeholders::_1, std::placeholders::_2);
+        tty.async_read_some(buffer, callback);
+    }
+
+    void OnReadTty(const DispatchFunc &dispatcher, asio::error_code ec,
+                   std::size_t n)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+
+        if (!dispatcher({byteArray, n}))
+        {
+            Quit();
+            return;
+        }
+
+        // next read
+        ReadTty(dispatcher);
+    }
+
+    // callback returns false to quit
+    void Signal(const std::function<bool(int)> &callback)
+    {
+        signals.async_wait(
+            [this, callback](const asio::error_code &ec, int signal) {
+                if (ec)
+                {
+                    return;
+                }
+                if (!callback(signal))
+                {
+                    Quit();
+                    return;
+                }
+                Signal(callback);
+            });
+    }
+
+    // step runs between other events until it returns true
+    void Idle(const std::function<bool()> &step)
+    {
+        if (m_idle)
+        {
+            return;
+        }
+        m_idle = true;
+        asio::post(context, [this, step]() {
+            m_idle = false;
+            if (!m_pty)
+            {
+                // quit
+                return;
+            }
+            if (!step())
+            {
+                Idle(step);
+            }
+        });
+    }
+
+    // callback returns false to stop waiting.
+    // more() true: output is left. call again from the loop without waiting
+    void WaitReadable(int fd, const std::function<bool()> &callback,
+                      const std::function<bool()> &more)
+    {
+        m_pty->async_wait(asio::posix::stream_descriptor::wait_read,
+                          [this, fd, callback, more](const asio::error_code &ec) {
+                              if (ec)
+                              {
+                                  return;
+                              }
+                              OnReadable(fd, callback, more);
+                          });
+    }
+
+    void OnReadable(int fd, const std::function<bool()> &callback,
+                    const std::function<bool()> &more)
+    {
+        if (!m_pty)
+        {
+            return;
+        }
+        if (!callback())
+        {
+            Quit();
+            return;
+        }
+        if (more())
+        {
+            // tty input and writes run before this
+            asio::post(context, [this, fd, callback, more]() {
+                OnReadable(fd, callback, more);
+            });
+            return;
+        }
+        WaitReadable(fd, callback, more);
+    }
+
+    // callback returns true while something is left to write
+    void WaitWritable(const std::function<bool()> &callback)
+    {
+        if (!m_pty || m_waitingWrite)
+        {
+            return;
+        }
+        m_waitingWrite = true;
+        m_pty->async_wait(asio::posix::stream_descriptor::wait_write,
+                          [this, callback](const asio::error_code &ec) {
+                              m_waitingWrite = false;
+                              if (ec)
+                              {
+                                  return;
+                              }
+                              if (callback())
+                              {
+                                  WaitWritable(callback);
+                              }
+                          });
+    }
+
+    void Open(int fd)
+    {
+        m_pty.reset(new asio::posix::stream_descriptor(context, dup(fd)));
+    }
+
+    void Run()
+    {
+        context.run();
+    }
+};
+
+// C-q
+static const char QUIT_KEY = 0x11;
+// C-]: browse the history. j/k, space/b, g/G. C-] or q to return
+static const char HISTORY_KEY = 0x1d;
+// history lines reflowed per idle step
+static const size_t STEP_LINES = 1024;
+
+static termgrid::TermSize get_size(int fd)
+{
+    winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col && ws.ws_row)
+    {
+        return {ws.ws_col, ws.ws_row};
+    }
+    return {80, 24};
+}
+
+class PtyView
+{
+    termgrid::TermcapEntryPtr m_entry;
+    termgrid::AnyBackend m_backend;
+    termgrid::PtyPane m_pane;
+    std::string m_title;
+
+    // term size
+    int m_cols = 0;
+    int m_lines = 0;
+
+    std::string m_frame;
+    termgrid::TermLine m_line;
+    // scrolled rows keep the version and are copied from here
+    termgrid::EncodedLineCache m_cache;
+    // redraw all rows and the header
+    bool m_full = true;
+
+    // lines scrolled off the top of the pane, wrapped to m_cols
+    termgrid::Scrollback m_history;
+    termgrid::ReflowIndex m_reflow;
+    std::vector<termgrid::WrapRow> m_wraps;
+    bool m_browsing = false;
+    // bottom row of the history view
+    size_t m_bottomLine = 0;
+    uint32_t m_bottomRow = 0;
+
+public:
+    PtyView(const termgrid::TermcapEntryPtr &entry,
+            const termgrid::AnyBackend &backend, const std::string &title)
+        : m_entry(entry), m_backend(backend),
+          m_pane({entry->columns(), entry->lines() - 1}, wcwidth_cjk),
+          m_title(title),
+          m_reflow([this](size_t i) -> const termgrid::TermLine & {
+              return m_history.Line(i);
+          })
+    {
+        m_cols = m_entry->columns();
+        m_lines = m_entry->lines();
+        m_pane.SetHistory(&m_history);
+        m_reflow.Resize(m_cols);
+    }
+
+    ~PtyView()
+    {
+        m_pane.Close();
+        // move
+        m_entry->cursor_xy(0, m_lines - 1);
+        m_entry->cursor_show(true);
+        std::cout << std::endl;
+    }
+
+    termgrid::PtyPane &pane()
+    {
+        return m_pane;
+    }
+
+    bool IsReflowComplete() const
+    {
+        return m_reflow.IsComplete();
+    }
+
+    bool Dispatch(std::string_view data)
+    {
+        while (data.size())
+        {
+            if (m_browsing)
+            {
+                // keys move the view. nothing goes to the child
+                auto c = data[0];
+                data.remove_prefix(1);
+                if (c == QUIT_KEY)
+                {
+                    return false;
+                }
+                Browse(c);
+                continue;
+            }
+            const char keys[] = {QUIT_KEY, HISTORY_KEY};
+            auto found = data.find_first_of(std::string_view(keys, 2));
+            m_pane.Write(data.substr(0, found));
+            if (found == std::string_view::npos)
+            {
+                break;
+            }
+            auto c = data[found];
+            data.remove_prefix(found + 1);
+            if (c == QUIT_KEY)
+            {
+                return false;
+            }
+            BeginHistory();
+        }
+        if (m_full)
+        {
+            Draw();
+        }
+        return true;
+    }
+
+    // child output
+    bool OnReadable()
+    {
+        auto alive = m_pane.Read();
+        m_reflow.Sync(m_history.size());
+        Draw();
+        return alive;
+    }
+
+    // SIGWINCH. the history is wrapped again to the new width by Step
+    void Resize(const termgrid::TermSize &size)
+    {
+        m_cols = size.width;
+        m_lines = size.height;
+        m_pane.Resize({m_cols, m_lines - 1});
+        m_reflow.Resize(m_cols);
+        if (m_browsing)
+        {
+            ScrollHistory(0);
+        }
+        m_full = true;
+        Draw();
+    }
+
+    // rows of the history lines not on the screen. true when done
+    bool Step()
+    {
+        auto done = m_reflow.Step(STEP_LINES);
+        if (done && m_browsing)
+        {
+            // total rows in the header
+            Draw();
+        }
+        return done;
+    }
+
+    void Draw()
+    {
+        m_frame.clear();
+        std::visit(
+            [this](const auto &b) {
+                DrawHeader(b);
+                if (m_browsing)
+                {
+                    DrawHistory(b);
+                }
+                else
+                {
+                    DrawScreen(b);
+                }
+            },
+            m_backend);
+        m_full = false;
+        m_pane.screen().ClearDirty();
+
+        auto p = m_frame.data();
+        auto size = m_frame.size();
+        while (size)
+        {
+            auto n = write(1, p, size);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            p += n;
+            size -= n;
+        }
+    }
+
+private:
+    void BeginHistory()
+    {
+        if (!m_history.size())
+        {
+            return;
+        }
+        m_browsing = true;
+        m_full = true;
+        m_bottomLine = m_history.size() - 1;
+        m_bottomRow = UINT32_MAX;
+        ScrollHistory(0);
+    }
+
+    void Browse(char c)
+    {
+        auto height = m_lines - 1;
+        switch (c)
+        {
+        case 'k':
+            ScrollHistory(-1);
+            break;
+        case 'j':
+            ScrollHistory(1);
+            break;
+        case 'b':
+            ScrollHistory(-height);
+            break;
+        case ' ':
+            ScrollHistory(height);
+            break;
+        case 'g':
+            ScrollHistory(INT32_MIN);
+            break;
+        case 'G':
+            ScrollHistory(INT32_MAX);
+            break;
+        case 'q':
+        case HISTORY_KEY:
+            m_browsing = false;
+            break;
+        default:
+            return;
+        }
+        m_full = true;
+    }
+
+    // move the bottom row. Move only reads the lines it passes
+    void ScrollHistory(int64_t rows)
+    {
+        m_reflow.Move(m_bottomLine, m_bottomRow, rows);
+        // a screen of rows above the bottom
+        size_t line = 0;
+        uint32_t row = 0;
+        m_reflow.Move(line, row, m_lines - 2);
+        if (std::make_pair(m_bottomLine, m_bottomRow) < std::make_pair(line, row))
+        {
+            m_bottomLine = line;
+            m_bottomRow = row;
+        }
+    }
+
+    template <typename B> void DrawHeader(const B &b)
+    {
+        if (!m_full && !m_browsing)
+        {
+            return;
+        }
+        auto header = m_title;
+        if (m_browsing)
+        {
+            header = "history: line " + std::to_string(m_bottomLine + 1) +
+                     " / " + std::to_string(m_history.size()) + ", rows " +
+                     (m_reflow.IsComplete() ? "" : "~") +
+                     std::to_string(m_reflow.TotalRows()) + " (C-]: back)";
+        }
+        b.cursor_xy(m_frame, 0, 0);
+        b.standout(m_frame, true);
+        m_frame.append(header.substr(0, m_cols));
+        b.standout(m_frame, false);
+        b.clear_to_eol(m_frame);
+    }
+
+    template <typename B> void DrawScreen(const B &b)
+    {
+        auto &screen = m_pane.screen();
+        for (int y = 0; y < screen.size().height; ++y)
+        {
+            if (!m_full && !screen.IsDirty(y))
+            {
+                continue;
+            }
+            screen.GetLine(y, m_line);
+            b.cursor_xy(m_frame, 0, 1 + y);
+            m_cache.Emit(m_frame, m_line.version, 0, m_cols,
+                         [this, &b](std::string &out) {
+                             b.encode_line(out, m_line.codes, m_cols);
+                             b.clear_to_eol(out);
+                         });
+        }
+        auto &parser = m_pane.parser();
+        b.cursor_xy(m_frame, parser.cursor().x, 1 + parser.cursor().y);
+        b.cursor_show(m_frame, parser.IsCursorVisible());
+    }
+
+    // only the visible lines are laid out
+    template <typename B> void DrawHistory(const B &b)
+    {
+        if (!m_full)
+        {
+            return;
+        }
+        auto height = m_lines - 1;
+        auto line = m_bottomLine;
+        auto row = m_bottomRow;
+        m_reflow.Move(line, row, -(height - 1));
+        m_reflow.Layout(line, m_wraps);
+        for (int y = 0; y < height; ++y)
+        {
+            b.cursor_xy(m_frame, 0, 1 + y);
+            if (line < m_history.size())
+            {
+                auto &codes = m_history.Line(line).codes;
+                auto begin = std::min<size_t>(m_wraps[row].begin, codes.size());
+                auto end = row + 1 < m_wraps.size()
+                               ? std::min<size_t>(m_wraps[row + 1].begin,
+                                                  codes.size())
+                               : codes.size();
+                b.encode_line(m_frame, {codes.data() + begin, end - begin},
+                              m_cols);
+                if (++row >= m_wraps.size())
+                {
+                    row = 0;
+                    if (++line < m_history.size())
+                    {
+                        m_reflow.Layout(line, m_wraps);
+                    }
+                }
+            }
+            b.clear_to_eol(m_frame);
+        }
+        b.cursor_show(m_frame, false);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " CMD [ARGS...]" << std::endl;
+        return 1;
+    }
+
+    auto entry = termgrid::TermcapEntry::create_from_env();
+    if (!entry)
+    {
+        return 1;
+    }
+    auto backend = termgrid::DetectBackend(getenv("TERM"), entry);
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string title =
+        "pty_view: " + args[0] + " (C-q: quit, C-]: history)";
+
+    // main loop
+    Asio asio(0);
+    {
+        PtyView d(entry, backend, title);
+        if (!d.pane().Spawn(args))
+        {
+            std::cerr << "fail to run: " << args[0] << std::endl;
+            return 2;
+        }
+        d.Draw();
+        // input is queued in the pane while the child does not read it
+        auto flush = [&d]() { return !d.pane().FlushInput(); };
+        auto idle = [&]() {
+            if (!d.IsReflowComplete())
+            {
+                asio.Idle([&d]() { return d.Step(); });
+            }
+        };
+        asio.Open(d.pane().fd());
+        asio.ReadTty([&](std::string_view data) {
+            auto alive = d.Dispatch(data);
+            if (alive && d.pane().HasPendingInput())
+            {
+                asio.WaitWritable(flush);
+            }
+            return alive;
+        });
+        asio.WaitReadable(
+            d.pane().fd(),
+            [&]() {
+                auto alive = d.OnReadable();
+                if (alive && d.pane().HasPendingInput())
+                {
+                    // DSR/DA replies
+                    asio.WaitWritable(flush);
+                }
+                idle();
+                return alive;
+            },
+            [&d]() { return d.pane().HasMoreOutput(); });
+        asio.Signal([&](int signal) {
+            if (signal != SIGWINCH)
+            {
+                return false;
+            }
+            d.Resize(get_size(0));
+            idle();
+            return true;
+        });
+        asio.Run();
+    }
+
+    return 0;
+}
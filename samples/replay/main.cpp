@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <termcap_entry.h>
+#include <encoder.h>
+#include <recorder.h>
+
+// replay FILE [--fast] [--headless]
+//
+// --fast: ignore timestamps
+// --headless: encode frames but write nothing
+int main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    bool fast = false;
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--fast")
+        {
+            fast = true;
+        }
+        else if (arg == "--headless")
+        {
+            headless = true;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!path)
+    {
+        std::cerr << "usage: " << argv[0] << " FILE [--fast] [--headless]"
+                  << std::endl;
+        return 1;
+    }
+
+    auto player = termgrid::Player::open(path);
+    if (!player)
+    {
+        std::cerr << "fail to open: " << path << std::endl;
+        return 2;
+    }
+
+    if (!headless && !isatty(1))
+    {
+        headless = true;
+    }
+    auto term = getenv("TERM");
+    auto entry =
+        std::make_shared<termgrid::TermcapEntry>(term ? term : "xterm-256color");
+
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    size_t frames = 0;
+    size_t inputs = 0;
+    size_t recordedBytes = 0;
+    size_t replayBytes = 0;
+    std::vector<int64_t> encodeTimes;
+    std::string frame;
+    termgrid::TermLine line;
+
+    if (!headless)
+    {
+        frame.clear();
+        entry->cursor_show(frame, false);
+        write(1, frame.data(), frame.size());
+    }
+
+    termgrid::Player::Event event;
+    while (player->Next(event))
+    {
+        if (event.type == termgrid::RecordTypes::Input)
+        {
+            ++inputs;
+            continue;
+        }
+
+        if (!fast)
+        {
+            std::this_thread::sleep_until(start + microseconds(event.time));
+        }
+
+        auto t0 = steady_clock::now();
+        frame.clear();
+        auto &screen = player->screen();
+        auto &size = screen.size();
+        for (int y = 0; y < size.height; ++y)
+        {
+            if (!screen.IsDirty(y))
+            {
+                continue;
+            }
+            screen.GetLine(y, line);
+            entry->cursor_xy(frame, 0, y);
+            termgrid::EncodeLine(frame, line.codes, size.width);
+            entry->clear_to_eol(frame);
+        }
+        screen.ClearDirty();
+        encodeTimes.push_back(
+            duration_cast<microseconds>(steady_clock::now() - t0).count());
+
+        if (!headless)
+        {
+            write(1, frame.data(), frame.size());
+        }
+
+        ++frames;
+        recordedBytes += event.bytes;
+        replayBytes += frame.size();
+    }
+    auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start);
+
+    if (!headless)
+    {
+        frame.clear();
+        entry->cursor_show(frame, true);
+        entry->cursor_xy(frame, 0, player->screen().size().height - 1);
+        write(1, frame.data(), frame.size());
+    }
+
+    std::sort(encodeTimes.begin(), encodeTimes.end());
+    auto percentile = [&encodeTimes](int p) -> int64_t {
+        if (encodeTimes.empty())
+        {
+            return 0;
+        }
+        return encodeTimes[(encodeTimes.size() - 1) * p / 100];
+    };
+    std::cerr << "frames: " << frames << ", inputs: " << inputs << std::endl
+              << "recorded bytes: " << recordedBytes << " ("
+              << (frames ? recordedBytes / frames : 0) << "/frame)" << std::endl
+              << "replay bytes: " << replayBytes << " ("
+              << (frames ? replayBytes / frames : 0) << "/frame)" << std::endl
+              << "encode us: p50 " << percentile(50) << ", p99 "
+              << percentile(99) << ", max " << percentile(100) << std::endl
+              << "elapsed: " << elapsed.count() << "ms" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#include <mailbox.h>
+#include <session.h>
+
+// status_server [--bench N] [TTY...]
+//
+// 1 つの status board を複数の端末に描く。
+// TTY: 他の端末の tty (/dev/pts/N)。TERM は環境変数と同じとみなす
+// --bench N: /dev/null への N session で Render の時間を測る
+//
+// snapshot は collector thread が作って LatestMailbox で渡す。
+// 描画が追いつかない間の古い snapshot は捨てられる
+static volatile std::sig_atomic_t s_quit = 0;
+
+static void put(termgrid::TermScreen &screen, int x, int y,
+                std::string_view text)
+{
+    termgrid::TermLine line;
+    for (auto &c : line.push(text))
+    {
+        // ascii only
+        c.cols = 1;
+    }
+    screen.Blit(x, y, line.codes, screen.size().width - x);
+}
+
+static termgrid::TermSize get_size(int fd)
+{
+    winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col && ws.ws_row)
+    {
+        return {ws.ws_col, ws.ws_row};
+    }
+    return {80, 24};
+}
+
+static termgrid::TermSnapshotPtr make_board(int frame, size_t sessions)
+{
+    termgrid::TermScreen screen({60, 12});
+    put(screen, 0, 0, "termgrid status board");
+    put(screen, 0, 2, fmt::format("frame    : {}", frame));
+    put(screen, 0, 3, fmt::format("sessions : {}", sessions));
+    for (int i = 0; i < 6; ++i)
+    {
+        auto load = (frame * (i + 3)) % 40;
+        put(screen, 0, 5 + i,
+            fmt::format("worker {} [{:<40}]", i, std::string(load, '#')));
+    }
+    return std::make_shared<termgrid::TermSnapshot>(screen);
+}
+
+int main(int argc, char **argv)
+{
+    auto term = getenv("TERM");
+    if (!term)
+    {
+        term = (char *)"xterm-256color";
+    }
+
+    termgrid::SessionServer server;
+    std::vector<int> fds;
+    int bench = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--bench" && i + 1 < argc)
+        {
+            bench = atoi(argv[++i]);
+            continue;
+        }
+        auto fd = open(argv[i], O_WRONLY | O_NOCTTY);
+        if (fd < 0)
+        {
+            std::cerr << "fail to open: " << argv[i] << std::endl;
+            continue;
+        }
+        fds.push_back(fd);
+        server.Attach(
+            std::make_shared<termgrid::TermSession>(fd, term, get_size(fd)));
+    }
+    for (int i = 0; i < bench; ++i)
+    {
+        auto fd = open("/dev/null", O_WRONLY);
+        fds.push_back(fd);
+        server.Attach(std::make_shared<termgrid::TermSession>(
+            fd, term, termgrid::TermSize{80, 24}));
+    }
+    if (server.size() == 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [--bench N] [TTY...]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, [](int) { s_quit = 1; });
+
+    // the collector thread builds snapshots and hands the newest one over
+    termgrid::LatestMailbox<termgrid::TermSnapshotPtr> mailbox;
+    termgrid::Wakeup wakeup;
+    std::atomic<size_t> sessions = server.size();
+    std::atomic<int> published = 0;
+    std::thread collector([&]() {
+        for (int frame = 0; !s_quit; ++frame)
+        {
+            if (mailbox.Publish(make_board(frame, sessions)))
+            {
+                wakeup.Notify();
+            }
+            ++published;
+            if (bench && frame >= 1000)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(
+                bench ? std::chrono::microseconds(100) : std::chrono::seconds(1));
+        }
+    });
+
+    int rendered = 0;
+    while (!s_quit)
+    {
+        pollfd pfd = {wakeup.fd(), POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            if (bench && published > 1000)
+            {
+                break;
+            }
+            continue;
+        }
+        wakeup.Clear();
+        termgrid::TermSnapshotPtr snapshot;
+        if (!mailbox.Take(snapshot))
+        {
+            continue;
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        auto skipped = server.Render(snapshot);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin);
+        ++rendered;
+        if (bench && rendered % 100 == 0)
+        {
+            std::cerr << fmt::format("render {}: {} sessions, {} skipped, {} us\n",
+                                     rendered, server.size(), skipped,
+                                     elapsed.count());
+        }
+    }
+    collector.join();
+    if (bench)
+    {
+        // frames built faster than rendered are dropped in the mailbox
+        std::cerr << fmt::format("published {}, rendered {}\n", published.load(),
+                                 rendered);
+    }
+
+    for (auto fd : fds)
+    {
+        close(fd);
+    }
+    return 0;
+}
@@ -11,21 +11,33 @@
 #include <fmt/core.h>
 #include <tcb/span.hpp>
 #include <termgrid.h>
+#include <encoder.h>
+#include <arena.h>
+#include <column_index.h>
+#include <recorder.h>
+#include <tty_writer.h>
+#include <input.h>
+#include <trace.h>
 
-using DispatchFunc = std::function<bool(int c)>;
+using DispatchFunc = std::function<bool(std::string_view data)>;
 
 #include "../../_external/wcwidth-cjk/wcwidth.c"
 
+// one read may hold many mouse reports
+static const size_t READ_SIZE = 4096;
+
 class Asio
 {
     asio::io_context context;
     asio::posix::stream_descriptor tty;
-    char byteArray[1];
+    char byteArray[READ_SIZE];
     asio::signal_set signals;
 
     termgrid::RawMode rawmode;
     termgrid::TermcapEntryPtr m_entry;
 
+    std::unique_ptr<asio::posix::stream_descriptor> m_output;
+
 public:
     Asio(int tty)
         : rawmode(tty), tty(context, tty),
@@ -60,9 +72,7 @@ public:
             return;
         }
 
-        // getch
-        auto c = byteArray[0];
-        if (!dispatcher(c))
+        if (!dispatcher({byteArray, n}))
         {
             Quit();
             return;
@@ -86,6 +96,21 @@ public:
         signals.async_wait(callback);
     }
 
+    void WaitWritable(int fd, const std::function<void()> &callback)
+    {
+        if (!m_output)
+        {
+            m_output.reset(new asio::posix::stream_descriptor(context, dup(fd)));
+        }
+        m_output->async_wait(asio::posix::stream_descriptor::wait_write,
+                             [callback](const asio::error_code &ec) {
+                                 if (!ec)
+                                 {
+                                     callback();
+                                 }
+                             });
+    }
+
     void Run()
     {
         context.run();
@@ -116,6 +141,105 @@ static bool replace_space(char32_t unicode)
     return false;
 }
 
+static std::string_view name_view(const char *name)
+{
+    return name;
+}
+static std::string_view name_view(const char8_t *name)
+{
+    return (const char *)name;
+}
+static std::string_view name_view(std::u8string_view name)
+{
+    return {(const char *)name.data(), name.size()};
+}
+static std::string_view name_view(std::string_view name)
+{
+    return name;
+}
+
+/// c8::unicode::get_block を 16 codepoint (1 row) 単位で引いて作る
+/// block の sorted range table。 lookup は binary search。
+class UnicodeBlockIndex
+{
+public:
+    struct Block
+    {
+        char32_t front;
+        // inclusive
+        char32_t back;
+        std::string name;
+    };
+
+private:
+    std::vector<Block> m_blocks;
+
+    UnicodeBlockIndex()
+    {
+        const char32_t UNICODE_END = 0x110000;
+        for (char32_t unicode = 0; unicode < UNICODE_END; unicode += 16)
+        {
+            auto block = c8::unicode::get_block(unicode);
+            auto name = name_view(block.name);
+            if (!m_blocks.empty() && m_blocks.back().front == block.front &&
+                m_blocks.back().name == name)
+            {
+                m_blocks.back().back = unicode + 15;
+                continue;
+            }
+            m_blocks.push_back({(char32_t)block.front, unicode + 15,
+                                std::string(name)});
+        }
+        m_blocks.shrink_to_fit();
+    }
+
+public:
+    static const UnicodeBlockIndex &instance()
+    {
+        static UnicodeBlockIndex s_index;
+        return s_index;
+    }
+
+    const Block &Find(char32_t unicode) const
+    {
+        // blocks cover 0..0x10FFFF without gap
+        auto found = std::lower_bound(
+            m_blocks.begin(), m_blocks.end(), unicode,
+            [](const Block &b, char32_t u) { return b.back < u; });
+        return *found;
+    }
+
+    /// case insensitive. start is searched first and wrap around
+    const Block *FindPrefix(std::string_view prefix, size_t start = 0) const
+    {
+        if (prefix.empty() || m_blocks.empty())
+        {
+            return nullptr;
+        }
+        for (size_t i = 0; i < m_blocks.size(); ++i)
+        {
+            auto &b = m_blocks[(start + i) % m_blocks.size()];
+            if (b.name.size() < prefix.size())
+            {
+                continue;
+            }
+            if (std::equal(prefix.begin(), prefix.end(), b.name.begin(),
+                           [](char l, char r) {
+                               return tolower(l) == tolower(r);
+                           }))
+            {
+                return &b;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t IndexOf(const Block &block) const
+    {
+        return &block - m_blocks.data();
+    }
+};
+
 static int get_cols(char32_t unicode)
 {
     if (unicode < 0x20 || (unicode >= 0x7F && unicode < 0xA0))
@@ -123,7 +247,7 @@ static int get_cols(char32_t unicode)
         return 0;
     }
 
-    auto block = c8::unicode::get_block(unicode);
+    auto &block = UnicodeBlockIndex::instance().Find(unicode);
 
     switch ((c8::unicode::UnicodeBlocks)block.front)
     {
@@ -177,6 +301,18 @@ static int get_cols(char32_t unicode)
     return 1;
 }
 
+// one column per codepoint
+static std::string_view skip_columns(std::string_view src, int cols)
+{
+    auto p = (const char8_t *)src.data();
+    auto end = p + src.size();
+    for (; p < end && cols > 0; --cols)
+    {
+        p += c8::utf8::codepoint(p).codeunit_count();
+    }
+    return src.substr(std::min<size_t>((const char *)p - src.data(), src.size()));
+}
+
 class UnicodeGrid
 {
     //      0 1 2 ... D E F
@@ -185,7 +321,14 @@ class UnicodeGrid
     // 4095
 
     int m_plane = -1;
-    std::array<termgrid::TermLine, 4096> m_lines;
+    // all lines are released at once by SetPlane
+    termgrid::FrameArena m_arena;
+    std::vector<termgrid::TermLine> m_lines;
+    std::vector<termgrid::ColumnIndex> m_indices;
+    // a line with a wide char cut at the left edge
+    std::vector<termgrid::TermLine> m_scratch;
+    // widest line
+    int m_cols = 0;
 
 public:
     UnicodeGrid()
@@ -200,13 +343,23 @@ public:
             return;
         }
         m_plane = unicode_plane;
+        m_lines.clear();
+        m_arena.reset();
+        m_indices.resize(4096);
+        m_scratch.resize(4096);
+        m_cols = 0;
         for (int j = 0; j < 4096; ++j)
         {
             auto unicode_base = (unicode_plane << 16) | (j << 4);
-            auto block = c8::unicode::get_block(unicode_base);
-            auto &l = m_lines[j];
-            l.clear();
-            l.push(fmt::format((const char *)u8"{:04X}│", unicode_base));
+            auto &block = UnicodeBlockIndex::instance().Find(unicode_base);
+            auto &l = m_lines.emplace_back(&m_arena);
+            // "XXXX│" + 16 * "c │" + block name
+            l.codes.reserve(128);
+            for (auto &c :
+                 l.push(fmt::format((const char *)u8"{:04X}│", unicode_base)))
+            {
+                c.cols = 1;
+            }
             for (int i = 0; i < 16; ++i)
             {
                 auto unicode = unicode_base + i;
@@ -246,50 +399,70 @@ public:
                     }
                 }
             }
-            l.push(block.name);
+            for (auto &c : l.push(block.name))
+            {
+                // ascii
+                c.cols = 1;
+            }
+            // scrolled rows are copied from the encoder cache
+            l.Touch();
+            m_indices[j].Build(l.codes);
+            m_cols = std::max(m_cols, m_indices[j].cols());
         }
     }
 
-    tcb::span<termgrid::TermCodepoint> GetLine(const termgrid::TermPoint &p)
+    int cols() const
     {
-        // TODO: p.x
-        return m_lines[p.y].codes;
+        return m_cols;
     }
 
-    using GetLineFunc = std::function<tcb::span<termgrid::TermCodepoint>(
-        const termgrid::TermPoint &)>;
+    // p.x is the left column
+    tcb::span<termgrid::TermCodepoint> GetLine(const termgrid::TermPoint &p,
+                                               int width)
+    {
+        return m_indices[p.y].Slice(m_lines[p.y].codes, p.x, width,
+                                    m_scratch[p.y]);
+    }
 
-    void RenderBlit(const termgrid::TermcapEntryPtr &entry,
-                    const GetLineFunc &getLine, const termgrid::TermPoint &src,
-                    const termgrid::TermSize &size,
-                    const termgrid::TermPoint &dst)
+    termgrid::TermLineRef GetLineRef(const termgrid::TermPoint &p, int width)
     {
-        for (int y = 0; y < size.height; ++y)
-        {
-            entry->cursor_xy(dst.x, dst.y + y);
-            auto line = getLine({src.x, src.y + y});
-            auto p = line.begin();
-            for (int x = 0; x < size.width && p != line.end(); ++p)
-            {
-                if (x + p->cols > size.width)
-                {
-                    // over eol
-                    break;
-                }
-                std::cout.write((const char *)p->cp.data(),
-                                p->cp.codeunit_count());
-                x += p->cols;
-            }
-            entry->clear_to_eol();
-        }
+        return {GetLine(p, width), m_lines[p.y].version};
+    }
+
+    // glyph at column x
+    termgrid::TermColumnHit HitTest(int x, int y) const
+    {
+        return m_indices[y].Find(m_lines[y].codes, x);
     }
 };
 using UnicodeGridPtr = std::shared_ptr<UnicodeGrid>;
 
 class UnicodeView
 {
+    Asio &m_asio;
     termgrid::TermcapEntryPtr m_entry;
     UnicodeGridPtr m_grid;
+    termgrid::ParallelEncoder m_encoder;
+    // frame before and after rows
+    std::string m_prefix;
+    std::string m_suffix;
+    std::string m_header;
+    std::string m_status;
+    std::string m_statusNormal;
+
+    termgrid::RecorderPtr m_recorder;
+    termgrid::TermScreen m_screen;
+    // T: write trace spans here
+    const char *m_tracePath;
+
+    // one frame in flight. Draw while writing only marks dirty
+    termgrid::TtyWriter m_writer;
+    std::string m_frame;
+    bool m_dirty = false;
+    int m_lastKey = 0;
+
+    termgrid::InputDecoder m_decoder;
+    std::vector<termgrid::InputEvent> m_events;
 
     // unicode plane: 0..0x10
     int m_plane = 0;
@@ -300,23 +473,47 @@ class UnicodeView
 
     // 0..(4095 - lines)
     int m_topline = 0;
+    // horizontal scroll. left column
+    int m_left = 0;
 
     // cursor x: 0..16
     int m_col = 0;
     // cursor y: 0..(lines-2)
     int m_line = 0;
 
+    // incremental search: block name prefix or hex codepoint
+    bool m_search = false;
+    std::string m_query;
+    static constexpr size_t MAX_QUERY = 64;
+    // Tab: search next block from here
+    size_t m_searchStart = 0;
+    std::string m_searchResult;
+    struct
+    {
+        int plane;
+        int topline;
+        int col;
+        int line;
+    } m_saved;
+
 public:
-    UnicodeView(const termgrid::TermcapEntryPtr &entry)
-        : m_entry(entry), m_grid(new UnicodeGrid)
+    UnicodeView(Asio &asio, const termgrid::TermcapEntryPtr &entry,
+                const termgrid::RecorderPtr &recorder = nullptr,
+                const char *tracePath = nullptr)
+        : m_asio(asio), m_entry(entry), m_grid(new UnicodeGrid),
+          m_recorder(recorder), m_tracePath(tracePath)
     {
         m_cols = m_entry->columns();
         m_lines = m_entry->lines();
+        std::cout << termgrid::MOUSE_ENABLE << termgrid::PASTE_ENABLE;
+        std::cout.flush();
         Draw();
     }
 
     ~UnicodeView()
     {
+        m_writer.Drain();
+        std::cout << termgrid::PASTE_DISABLE << termgrid::MOUSE_DISABLE;
         // move
         m_entry->cursor_xy(0, m_lines - 1);
         std::cout.flush();
@@ -324,63 +521,433 @@ public:
 
     void Draw(int c = 0)
     {
+        m_lastKey = c;
+        if (m_writer.IsBusy())
+        {
+            // merged into the frame after the current one is written
+            m_dirty = true;
+            return;
+        }
+        m_dirty = false;
+        TERMGRID_TRACE_SCOPE("draw");
+
         m_grid->SetPlane(m_plane);
 
-        m_entry->cursor_show(false);
-        m_grid->RenderBlit(m_entry,
-                           [g = m_grid](const termgrid::TermPoint &p) {
-                               return g->GetLine(p);
-                           },
-                           {0, m_topline}, {m_cols, m_lines - 2}, {0, 1});
+        m_prefix.clear();
+        m_entry->cursor_show(m_prefix, false);
+        m_encoder.Encode(m_entry,
+                         [g = m_grid, w = m_cols](const termgrid::TermPoint &p) {
+                             return g->GetLineRef(p, w);
+                         },
+                         {m_left, m_topline}, {m_cols, m_lines - 2}, {0, 1});
 
+        m_suffix.clear();
+        m_header = fmt::format(
+            "    │00│01│02│03│04│05│06│07│08│09│0a│0b│0c│0d│0e│0f│"
+            "Unicode PLANE: {}",
+            m_plane);
+        m_header = skip_columns(m_header, m_left);
         {
-            m_entry->cursor_xy(0, 0);
-            m_entry->standout(true);
-            std::cout << "    │00│01│02│03│04│05│06│07│08│09│0a│0b│0c│0d│0e│0f│"
-                      << "Unicode PLANE: " << m_plane;
-            m_entry->clear_to_eol();
-            m_entry->standout(false);
+            m_entry->cursor_xy(m_suffix, 0, 0);
+            m_entry->standout(m_suffix, true);
+            m_suffix += m_header;
+            m_entry->clear_to_eol(m_suffix);
+            m_entry->standout(m_suffix, false);
         }
 
-        if (c)
+        // standout part and normal part
+        m_status.clear();
+        m_statusNormal.clear();
+        if (m_search)
         {
-            m_entry->standout(true);
-            m_entry->cursor_xy(0, m_lines - 1);
-            std::cout << "key: 0x" << std::hex << c << "(" << (char)c << ")";
-            m_entry->clear_to_eol();
-            m_entry->standout(false);
+            m_status = "/" + m_query;
+            m_statusNormal = "  " + m_searchResult;
+        }
+        else if (c)
+        {
+            m_status = fmt::format("key: 0x{:x}({})", c, (char)c);
+        }
+        if (m_status.size())
+        {
+            m_entry->cursor_xy(m_suffix, 0, m_lines - 1);
+            m_entry->standout(m_suffix, true);
+            m_suffix += m_status;
+            m_entry->standout(m_suffix, false);
+            m_suffix += m_statusNormal;
+            m_entry->clear_to_eol(m_suffix);
         }
 
-        m_entry->cursor_xy(5 + m_col * 3, m_line + 1);
-        m_entry->cursor_show(true);
-        std::cout.flush();
+        if (m_search)
+        {
+            m_entry->cursor_xy(m_suffix, 1 + m_query.size(), m_lines - 1);
+        }
+        else
+        {
+            m_entry->cursor_xy(m_suffix, 5 + m_col * 3 - m_left, m_line + 1);
+        }
+        m_entry->cursor_show(m_suffix, true);
+
+        m_frame.clear();
+        m_frame += m_prefix;
+        m_encoder.CopyTo(m_frame);
+        m_frame += m_suffix;
+        auto bytes = m_frame.size();
+        m_writer.Submit(m_frame);
+        if (!m_writer.Flush())
+        {
+            WaitWritable();
+        }
+
+        Record(bytes);
     }
 
-    bool Dispatch(int c)
+    void WaitWritable()
     {
-        if (c == 'q' || c == 0x1b)
+        m_asio.WaitWritable(m_writer.fd(), [this] { OnWritable(); });
+    }
+
+    void OnWritable()
+    {
+        if (!m_writer.Flush())
+        {
+            WaitWritable();
+            return;
+        }
+        if (m_dirty)
         {
+            // latest state only
+            Draw(m_lastKey);
+        }
+    }
+
+    void Record(size_t bytes)
+    {
+        if (!m_recorder)
+        {
+            return;
+        }
+
+        auto &size = m_screen.size();
+        if (size.width != m_cols || size.height != m_lines)
+        {
+            m_screen.Resize({m_cols, m_lines});
+        }
+
+        auto text = [](termgrid::TermLine &l, std::string_view src,
+                       int flags) {
+            for (auto &c : l.push(src))
+            {
+                c.cols = 1;
+                c.flags = flags;
+            }
+        };
+        auto standout = (int)termgrid::TermFlags::Standout;
+
+        termgrid::TermLine line;
+        text(line, m_header, standout);
+        m_screen.Blit(0, 0, line.codes, m_cols);
+        for (int y = 0; y < m_lines - 2; ++y)
+        {
+            m_screen.Blit(0, 1 + y,
+                          m_grid->GetLine({m_left, m_topline + y}, m_cols),
+                          m_cols);
+        }
+        if (m_status.size())
+        {
+            line.clear();
+            text(line, m_status, standout);
+            text(line, m_statusNormal, 0);
+            m_screen.Blit(0, m_lines - 1, line.codes, m_cols);
+        }
+
+        m_recorder->Frame(m_screen, bytes);
+    }
+
+    // "U+1F600", "1f600"
+    static bool parse_codepoint(std::string_view src, char32_t *unicode)
+    {
+        if (src.size() >= 2 && (src[0] == 'U' || src[0] == 'u') &&
+            src[1] == '+')
+        {
+            src = src.substr(2);
+        }
+        else if (src.empty() || !isdigit(src[0]))
+        {
+            // block names do not start with a digit
             return false;
         }
+        if (src.empty() || src.size() > 6)
+        {
+            return false;
+        }
+
+        char32_t value = 0;
+        for (auto c : src)
+        {
+            if (!isxdigit(c))
+            {
+                return false;
+            }
+            value = value * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+        }
+        if (value > 0x10FFFF)
+        {
+            return false;
+        }
+        *unicode = value;
+        return true;
+    }
+
+    void Jump(char32_t unicode)
+    {
+        auto height = m_lines - 2;
+        int row = (unicode & 0xFFFF) >> 4;
+        m_plane = unicode >> 16;
+        m_topline = std::clamp(row, 0, 4096 - height);
+        m_line = row - m_topline;
+        m_col = unicode & 0xF;
+    }
+
+    void Search()
+    {
+        auto &index = UnicodeBlockIndex::instance();
+        char32_t unicode;
+        if (parse_codepoint(m_query, &unicode))
+        {
+            Jump(unicode);
+            m_searchResult = fmt::format("U+{:04X} {}", (uint32_t)unicode,
+                                         index.Find(unicode).name);
+            return;
+        }
+
+        auto found = index.FindPrefix(m_query, m_searchStart);
+        if (!found)
+        {
+            m_searchResult = m_query.empty() ? "" : "not found";
+            return;
+        }
+        Jump(found->front);
+        m_searchStart = index.IndexOf(*found);
+        m_searchResult = fmt::format("U+{:04X} {}", (uint32_t)found->front,
+                                     found->name);
+    }
+
+    void DispatchSearch(int c)
+    {
+        switch (c)
+        {
+        case '\r':
+        case '\n':
+            m_search = false;
+            return;
+
+        case 0x1b:
+            // cancel
+            m_plane = m_saved.plane;
+            m_topline = m_saved.topline;
+            m_col = m_saved.col;
+            m_line = m_saved.line;
+            m_search = false;
+            return;
+
+        case 0x7f:
+        case '\b':
+            if (!m_query.empty())
+            {
+                m_query.pop_back();
+            }
+            m_searchStart = 0;
+            break;
+
+        case '\t':
+            // next match
+            ++m_searchStart;
+            break;
+
+        default:
+            // TermKeys and utf-8 bytes are out of isprint range
+            if (c >= 0x80 || !isprint(c))
+            {
+                return;
+            }
+            m_query.push_back(c);
+            m_searchStart = 0;
+            break;
+        }
+
+        Search();
+    }
+
+    // draw once for all events of a read
+    bool OnInput(std::string_view data)
+    {
+        if (m_recorder)
+        {
+            m_recorder->Input(data);
+        }
 
         m_cols = m_entry->columns();
         m_lines = m_entry->lines();
+
+        m_events.clear();
+        m_decoder.Feed(data, m_events);
+        if (data.size() < READ_SIZE)
+        {
+            // nothing follows a trailing ESC. it is the ESC key
+            m_decoder.FlushEscape(m_events);
+        }
+        termgrid::CoalesceEvents(m_events);
+        if (m_events.empty())
+        {
+            return true;
+        }
+
+        int key = m_lastKey;
+        bool pasting = false;
+        {
+            TERMGRID_TRACE_SCOPE("dispatch");
+            for (auto &e : m_events)
+            {
+                if (e.type == termgrid::InputTypes::Mouse)
+                {
+                    DispatchMouse(e.mouse);
+                    continue;
+                }
+                if (e.type == termgrid::InputTypes::Paste)
+                {
+                    DispatchPaste(e.text);
+                    pasting = !e.pasteEnd;
+                    continue;
+                }
+                if (!DispatchKey(e.key))
+                {
+                    return false;
+                }
+                key = e.key;
+            }
+        }
+
+        if (!pasting)
+        {
+            // draw after the last chunk of a long paste
+            Draw(key);
+        }
+        return true;
+    }
+
+    void DispatchPaste(std::string_view text)
+    {
+        if (!m_search)
+        {
+            // not keystrokes
+            return;
+        }
+
+        // first line into the query
+        auto end = std::find_if(text.begin(), text.end(),
+                                [](char c) { return c == '\r' || c == '\n'; });
+        if (end == text.begin() || m_query.size() >= MAX_QUERY)
+        {
+            return;
+        }
+        auto n = std::min<size_t>(end - text.begin(), MAX_QUERY - m_query.size());
+        m_query.append(text.data(), n);
+        m_searchStart = 0;
+        Search();
+    }
+
+    void DispatchMouse(const termgrid::MouseEvent &mouse)
+    {
+        if (m_search)
+        {
+            return;
+        }
+
+        switch (mouse.action)
+        {
+        case termgrid::MouseActions::Wheel:
+            m_topline += mouse.wheel * 3;
+            break;
+
+        case termgrid::MouseActions::Press:
+        case termgrid::MouseActions::Drag:
+            if (mouse.button == 0 && mouse.y >= 1 && mouse.y < m_lines - 1)
+            {
+                // the glyph under the pointer. cell is 3 columns from x=5
+                auto hit = m_grid->HitTest(m_left + mouse.x, m_topline + mouse.y - 1);
+                if (hit.col >= 5 && hit.col < 5 + 16 * 3)
+                {
+                    m_col = (hit.col - 5) / 3;
+                    m_line = mouse.y - 1;
+                    ScrollToCursor();
+                }
+            }
+            break;
+
+        default:
+            return;
+        }
+        Clamp();
+    }
+
+    bool DispatchKey(int c)
+    {
+        if (m_search)
+        {
+            DispatchSearch(c);
+            return true;
+        }
+
+        if (c == 'q' || c == 0x1b)
+        {
+            return false;
+        }
+
         auto height = m_lines - 2;
         switch (c)
         {
+        case '/':
+            m_search = true;
+            m_query.clear();
+            m_searchStart = 0;
+            m_searchResult.clear();
+            m_saved = {m_plane, m_topline, m_col, m_line};
+            break;
+
         case 'h':
-            --m_col;
+        case termgrid::TermKeys_Left:
+            m_col = std::max(m_col - 1, 0);
+            ScrollToCursor();
             break;
 
         case 'l':
-            ++m_col;
+        case termgrid::TermKeys_Right:
+            m_col = std::min(m_col + 1, 16 - 1);
+            ScrollToCursor();
+            break;
+
+        case 'H':
+            m_left -= 8;
+            break;
+
+        case 'T':
+            if (m_tracePath)
+            {
+                termgrid::WriteTrace(m_tracePath);
+            }
+            break;
+
+        case 'L':
+            m_left += 8;
             break;
 
         case 'j':
+        case termgrid::TermKeys_Down:
             ++m_line;
             break;
 
         case 'k':
+        case termgrid::TermKeys_Up:
             --m_line;
             break;
 
@@ -401,10 +968,12 @@ public:
             break;
 
         case 'g':
+        case termgrid::TermKeys_Home:
             m_topline = 0;
             break;
 
         case 'G':
+        case termgrid::TermKeys_End:
             m_topline = 0xFFFF;
             break;
 
@@ -417,6 +986,27 @@ public:
             break;
         }
 
+        Clamp();
+        return true;
+    }
+
+    // after the cursor moved
+    void ScrollToCursor()
+    {
+        auto x = 5 + m_col * 3;
+        if (x < m_left)
+        {
+            m_left = x;
+        }
+        else if (x + 2 > m_left + m_cols)
+        {
+            m_left = x + 2 - m_cols;
+        }
+    }
+
+    void Clamp()
+    {
+        auto height = m_lines - 2;
         if (m_line < 0)
         {
             m_topline += m_line;
@@ -428,13 +1018,19 @@ public:
             m_line = height - 1;
         }
         m_col = std::clamp(m_col, 0, 16 - 1);
+        m_left = std::clamp(m_left, 0, std::max(0, m_grid->cols() - m_cols));
+        {
+            // keep the cursor in view
+            auto left = std::max(0, m_left - 5 + 2) / 3;
+            auto right = (m_left + m_cols - 2 - 5) / 3;
+            if (left <= right)
+            {
+                m_col = std::clamp(m_col, left, right);
+            }
+        }
         m_topline = std::clamp(m_topline, 0, 4096 - height);
         m_plane =
             std::clamp(m_plane, 0, (int)c8::unicode::UnicodePlanes::SPUA_B);
-
-        Draw(c);
-
-        return true;
     }
 };
 
@@ -446,14 +1042,40 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // -r FILE: record frames for replay
+    // -t FILE: write trace spans at exit and by T (build with TERMGRID_TRACE)
+    termgrid::RecorderPtr recorder;
+    const char *tracePath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        auto option = std::string_view(argv[i]);
+        if (option == "-r")
+        {
+            recorder = std::make_shared<termgrid::Recorder>(argv[i + 1]);
+            if (!recorder->IsOpen())
+            {
+                std::cerr << "fail to open: " << argv[i + 1] << std::endl;
+                return 2;
+            }
+        }
+        else if (option == "-t")
+        {
+            tracePath = argv[i + 1];
+        }
+    }
+
     // main loop
     Asio asio(0);
     {
-        UnicodeView d(entry);
-        asio.ReadTty([&d](int c) { return d.Dispatch(c); });
+        UnicodeView d(asio, entry, recorder, tracePath);
+        asio.ReadTty([&d](std::string_view data) { return d.OnInput(data); });
         asio.Signal();
         asio.Run();
     }
+    if (tracePath && !termgrid::WriteTrace(tracePath))
+    {
+        std::cerr << "fail to write: " << tracePath << std::endl;
+    }
 
     return 0;
 }
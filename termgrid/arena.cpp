@@ -0,0 +1,83 @@
+#include "arena.h"
+#include <algorithm>
+
+namespace termgrid
+{
+
+static size_t align_up(size_t n, size_t alignment)
+{
+    return (n + alignment - 1) & ~(alignment - 1);
+}
+
+FrameArena::FrameArena(size_t chunkSize, std::pmr::memory_resource *upstream)
+    : m_upstream(upstream), m_chunkSize(chunkSize)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    release();
+}
+
+void FrameArena::reset()
+{
+    m_current = 0;
+    m_offset = 0;
+}
+
+void FrameArena::release()
+{
+    for (auto &chunk : m_chunks)
+    {
+        m_upstream->deallocate(chunk.data, chunk.size,
+                               alignof(std::max_align_t));
+    }
+    m_chunks.clear();
+    reset();
+}
+
+size_t FrameArena::capacity() const
+{
+    size_t size = 0;
+    for (auto &chunk : m_chunks)
+    {
+        size += chunk.size;
+    }
+    return size;
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    for (; m_current < m_chunks.size(); ++m_current, m_offset = 0)
+    {
+        auto &chunk = m_chunks[m_current];
+        auto offset = align_up(m_offset, alignment);
+        if (offset + bytes <= chunk.size)
+        {
+            m_offset = offset + bytes;
+            return chunk.data + offset;
+        }
+    }
+
+    // grow geometrically
+    auto size = m_chunks.empty() ? m_chunkSize : m_chunks.back().size * 2;
+    size = std::max(size, align_up(bytes, alignof(std::max_align_t)));
+    auto data = (char *)m_upstream->allocate(size, alignof(std::max_align_t));
+    m_chunks.push_back({data, size});
+    m_current = m_chunks.size() - 1;
+    m_offset = bytes;
+    return data;
+}
+
+void FrameArena::do_deallocate(void *, size_t, size_t)
+{
+    // released by reset
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource &other) const
+    noexcept
+{
+    return this == &other;
+}
+
+} // namespace termgrid
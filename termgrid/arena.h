@@ -0,0 +1,64 @@
+#pragma once
+#include <memory_resource>
+#include <vector>
+
+namespace termgrid
+{
+
+/// frame 単位でまとめて捨てる bump allocator。
+///
+/// deallocate は何もしない。reset で先頭に巻き戻し、確保済みの chunk は次の frame
+/// で使いまわす。 grid の作り直しのような一時的な行の churn 用。
+class FrameArena : public std::pmr::memory_resource
+{
+    struct Chunk
+    {
+        char *data;
+        size_t size;
+    };
+
+    std::pmr::memory_resource *m_upstream;
+    size_t m_chunkSize;
+    std::vector<Chunk> m_chunks;
+    size_t m_current = 0;
+    size_t m_offset = 0;
+
+public:
+    FrameArena(size_t chunkSize = 64 * 1024,
+               std::pmr::memory_resource *upstream =
+                   std::pmr::new_delete_resource());
+    ~FrameArena();
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // rewind. keep chunks for reuse
+    void reset();
+
+    // return all chunks to upstream
+    void release();
+
+    // bytes reserved from upstream
+    size_t capacity() const;
+
+private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const
+        noexcept override;
+};
+
+/// 寿命がばらばらの行用。解放された block を size class ごとに使いまわす。
+/// thread safe ではない。
+class PooledResource : public std::pmr::unsynchronized_pool_resource
+{
+public:
+    PooledResource(std::pmr::memory_resource *upstream =
+                       std::pmr::new_delete_resource())
+        : std::pmr::unsynchronized_pool_resource(
+              // larger blocks go to upstream directly
+              {64, 128 * 1024}, upstream)
+    {
+    }
+};
+
+} // namespace termgrid
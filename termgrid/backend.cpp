@@ -0,0 +1,48 @@
+#include "backend.h"
+#include "trace.h"
+
+namespace termgrid
+{
+
+template <typename T> static bool is(std::string_view term)
+{
+    return term == T::name;
+}
+
+AnyBackend DetectBackend(const char *term, const TermcapEntryPtr &entry)
+{
+    std::string_view name = term ? term : "";
+    if (is<Xterm256>(name))
+    {
+        return Backend<Xterm256>();
+    }
+    if (is<Tmux256>(name))
+    {
+        return Backend<Tmux256>();
+    }
+    if (is<Screen>(name))
+    {
+        return Backend<Screen>();
+    }
+    if (is<Screen256>(name))
+    {
+        return Backend<Screen256>();
+    }
+    // no Co is -1
+    auto colors = entry ? entry->colors() : 0;
+    return RuntimeBackend{entry, colors > 0 && colors < 256 ? 8 : 256};
+}
+
+void RenderBlit(std::string &out, const AnyBackend &backend,
+                const GetLineFunc &getLine, const TermPoint &src,
+                const TermSize &size, const TermPoint &dst)
+{
+    TERMGRID_TRACE_SCOPE("encode");
+    std::visit(
+        [&](const auto &b) {
+            RenderBlitBackend(out, b, getLine, src, size, dst);
+        },
+        backend);
+}
+
+} // namespace termgrid
@@ -0,0 +1,208 @@
+#pragma once
+#include "encoder.h"
+#include "sgr.h"
+#include "termcap_entry.h"
+#include <string_view>
+#include <variant>
+
+namespace termgrid
+{
+
+//
+// 既知の端末の escape sequence (terminfo と同じ)
+//
+struct Xterm256
+{
+    static constexpr std::string_view name = "xterm-256color";
+    static constexpr int colors = 256;
+    static constexpr std::string_view el = "\033[K";
+    static constexpr std::string_view civis = "\033[?25l";
+    static constexpr std::string_view cnorm = "\033[?12l\033[?25h";
+    static constexpr std::string_view smso = "\033[7m";
+    static constexpr std::string_view rmso = "\033[27m";
+};
+
+struct Tmux256
+{
+    static constexpr std::string_view name = "tmux-256color";
+    static constexpr int colors = 256;
+    static constexpr std::string_view el = "\033[K";
+    static constexpr std::string_view civis = "\033[?25l";
+    static constexpr std::string_view cnorm = "\033[34h\033[?25h";
+    static constexpr std::string_view smso = "\033[7m";
+    static constexpr std::string_view rmso = "\033[27m";
+};
+
+struct Screen
+{
+    static constexpr std::string_view name = "screen";
+    static constexpr int colors = 8;
+    static constexpr std::string_view el = "\033[K";
+    static constexpr std::string_view civis = "\033[?25l";
+    static constexpr std::string_view cnorm = "\033[34h\033[?25h";
+    static constexpr std::string_view smso = "\033[3m";
+    static constexpr std::string_view rmso = "\033[23m";
+};
+
+struct Screen256 : Screen
+{
+    static constexpr std::string_view name = "screen-256color";
+    static constexpr int colors = 256;
+};
+
+/// escape sequence が constexpr の backend。
+/// cup, csr, indn はどれも ansi なので共通。
+/// 4 つの端末はどれも terminfo に indn があるので、scroll_forward も
+/// RuntimeBackend (ind / indn) と同じ byte 列になる。
+template <typename T> struct Backend
+{
+    using Terminal = T;
+    static constexpr int colors = T::colors;
+
+    void cursor_xy(std::string &out, int col, int line) const
+    {
+        out.append("\033[");
+        detail::append_int(out, line + 1);
+        out.push_back(';');
+        detail::append_int(out, col + 1);
+        out.push_back('H');
+    }
+
+    void clear_to_eol(std::string &out) const
+    {
+        out.append(T::el);
+    }
+
+    void cursor_show(std::string &out, bool enable) const
+    {
+        out.append(enable ? T::cnorm : T::civis);
+    }
+
+    void standout(std::string &out, bool enable) const
+    {
+        out.append(enable ? T::smso : T::rmso);
+    }
+
+    void scroll_region(std::string &out, int top, int bottom) const
+    {
+        out.append("\033[");
+        detail::append_int(out, top + 1);
+        out.push_back(';');
+        detail::append_int(out, bottom + 1);
+        out.push_back('r');
+    }
+
+    void scroll_forward(std::string &out, int n) const
+    {
+        if (n == 1)
+        {
+            out.push_back('\n');
+            return;
+        }
+        out.append("\033[");
+        detail::append_int(out, n);
+        out.push_back('S');
+    }
+
+    void encode_line(std::string &out, tcb::span<const TermCodepoint> line,
+                     int width) const
+    {
+        detail::encode_cells<T::colors>(out, line.data(),
+                                        line.data() + line.size(), width);
+    }
+
+    void encode_styled_line(std::string &out, const StyledLine &line,
+                            const TermStyleTable &table, int width) const
+    {
+        detail::encode_runs<T::colors>(out, line, table, width);
+    }
+};
+
+/// terminfo を引く fallback
+struct RuntimeBackend
+{
+    TermcapEntryPtr entry;
+    // 8: terminfo Co < 256. 256 and 24bit colors are mapped down like
+    // Backend<Screen>. 256: same as EncodeLine
+    int colors = 256;
+
+    void cursor_xy(std::string &out, int col, int line) const
+    {
+        entry->cursor_xy(out, col, line);
+    }
+
+    void clear_to_eol(std::string &out) const
+    {
+        entry->clear_to_eol(out);
+    }
+
+    void cursor_show(std::string &out, bool enable) const
+    {
+        entry->cursor_show(out, enable);
+    }
+
+    void standout(std::string &out, bool enable) const
+    {
+        entry->standout(out, enable);
+    }
+
+    void scroll_region(std::string &out, int top, int bottom) const
+    {
+        entry->scroll_region(out, top, bottom);
+    }
+
+    void scroll_forward(std::string &out, int n) const
+    {
+        entry->scroll_forward(out, n);
+    }
+
+    void encode_line(std::string &out, tcb::span<const TermCodepoint> line,
+                     int width) const
+    {
+        if (colors < 256)
+        {
+            detail::encode_cells<8>(out, line.data(), line.data() + line.size(),
+                                    width);
+            return;
+        }
+        EncodeLine(out, line, width);
+    }
+
+    void encode_styled_line(std::string &out, const StyledLine &line,
+                            const TermStyleTable &table, int width) const
+    {
+        if (colors < 256)
+        {
+            detail::encode_runs<8>(out, line, table, width);
+            return;
+        }
+        EncodeStyledLine(out, line, table, width);
+    }
+};
+
+using AnyBackend = std::variant<Backend<Xterm256>, Backend<Tmux256>,
+                                Backend<Screen>, Backend<Screen256>,
+                                RuntimeBackend>;
+
+/// 起動時に 1 回呼ぶ。知らない端末は RuntimeBackend
+AnyBackend DetectBackend(const char *term, const TermcapEntryPtr &entry);
+
+template <typename B>
+void RenderBlitBackend(std::string &out, const B &backend,
+                       const GetLineFunc &getLine, const TermPoint &src,
+                       const TermSize &size, const TermPoint &dst)
+{
+    for (int y = 0; y < size.height; ++y)
+    {
+        backend.cursor_xy(out, dst.x, dst.y + y);
+        backend.encode_line(out, getLine({src.x, src.y + y}), size.width);
+        backend.clear_to_eol(out);
+    }
+}
+
+/// backend の選択は frame ごとに 1 回だけ。行と cell の loop は backend ごとに展開される
+void RenderBlit(std::string &out, const AnyBackend &backend,
+                const GetLineFunc &getLine, const TermPoint &src,
+                const TermSize &size, const TermPoint &dst);
+
+} // namespace termgrid
@@ -0,0 +1,68 @@
+#pragma once
+#include "termgrid.h"
+#include <vector>
+
+namespace termgrid
+{
+
+// little endian base 128
+inline void push_varint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// false if it crosses end or is longer than 64 bits
+inline bool read_varint(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        auto b = *p++;
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// type and rgb if not Default
+inline void push_color(std::vector<uint8_t> &out, const TermColor &color)
+{
+    out.push_back((uint8_t)color.type);
+    if (color.type != TermColorTypes::Default)
+    {
+        out.push_back(color.r);
+        out.push_back(color.g);
+        out.push_back(color.b);
+    }
+}
+
+inline bool read_color(const uint8_t *&p, const uint8_t *end, TermColor &color)
+{
+    color = {};
+    if (p >= end)
+    {
+        return false;
+    }
+    color.type = (TermColorTypes)*p++;
+    if (color.type != TermColorTypes::Default)
+    {
+        if (end - p < 3)
+        {
+            return false;
+        }
+        color.r = *p++;
+        color.g = *p++;
+        color.b = *p++;
+    }
+    return true;
+}
+
+} // namespace termgrid
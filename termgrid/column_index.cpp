@@ -0,0 +1,93 @@
+#include "column_index.h"
+#include <algorithm>
+
+namespace termgrid
+{
+
+void ColumnIndex::Build(tcb::span<const TermCodepoint> line)
+{
+    m_sums.clear();
+    m_sums.reserve(line.size() / STRIDE + 1);
+    m_size = line.size();
+    uint32_t x = 0;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        if (i % STRIDE == 0)
+        {
+            m_sums.push_back(x);
+        }
+        x += std::max(0, line[i].cols);
+    }
+    if (m_sums.empty())
+    {
+        m_sums.push_back(0);
+    }
+    m_cols = (int)x;
+}
+
+TermColumnHit ColumnIndex::Find(tcb::span<const TermCodepoint> line,
+                                int x) const
+{
+    if (x >= m_cols)
+    {
+        return {m_size, m_cols};
+    }
+    x = std::max(x, 0);
+
+    auto k = std::upper_bound(m_sums.begin(), m_sums.end(), (uint32_t)x) -
+             m_sums.begin() - 1;
+    auto i = k * STRIDE;
+    int col = m_sums[k];
+    // the checkpoint may be inside a cluster
+    while (i > 0 && line[i - 1].cols <= 0)
+    {
+        --i;
+    }
+    for (;;)
+    {
+        auto begin = i;
+        while (line[i].cols <= 0)
+        {
+            // x < m_cols. a glyph with cols follows
+            ++i;
+        }
+        auto next = col + line[i].cols;
+        if (x < next)
+        {
+            return {begin, col};
+        }
+        col = next;
+        ++i;
+    }
+}
+
+tcb::span<TermCodepoint> ColumnIndex::Slice(tcb::span<TermCodepoint> line,
+                                            int x, int width,
+                                            TermLine &scratch) const
+{
+    auto hit = Find(line, x);
+    if (hit.col == x || hit.index >= line.size())
+    {
+        return line.subspan(hit.index);
+    }
+
+    // wide glyph straddles the left edge
+    auto glyph = hit.index;
+    while (line[glyph].cols <= 0)
+    {
+        ++glyph;
+    }
+    // the glyph at x + width is out or straddles the right edge
+    auto end = Find(line, x + width).index;
+
+    scratch.clear();
+    auto blank = line[glyph];
+    blank.cp = c8::utf8::codepoint(u8" ");
+    blank.cols = 1;
+    scratch.codes.assign(hit.col + line[glyph].cols - x, blank);
+    scratch.codes.insert(scratch.codes.end(), line.begin() + glyph + 1,
+                         line.begin() + std::max(end, glyph + 1));
+    return scratch.codes;
+}
+
+} // namespace termgrid
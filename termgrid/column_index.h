@@ -0,0 +1,59 @@
+#pragma once
+#include "termgrid.h"
+#include <vector>
+
+namespace termgrid
+{
+
+/// ColumnIndex::Find の結果
+struct TermColumnHit
+{
+    // first codepoint of the glyph. cols == 0 codepoints before it included
+    size_t index;
+    // column where the glyph starts. <= x
+    int col;
+};
+
+/// 1 行の column → codepoint の index。
+///
+/// STRIDE codepoint ごとの累積 column だけ持つので memory は行の 1/STRIDE 程度。
+/// Find は checkpoint を二分探索して最大 STRIDE codepoint 歩く。
+/// 何千 column もある行の途中から描く (横 scroll) ときや
+/// mouse の column から文字を引くときに先頭から数えなくてよい。
+class ColumnIndex
+{
+public:
+    static const size_t STRIDE = 32;
+
+private:
+    // m_sums[k]: columns before codepoint k * STRIDE
+    std::vector<uint32_t> m_sums;
+    size_t m_size = 0;
+    int m_cols = 0;
+
+public:
+    /// line が変わったら作り直す
+    void Build(tcb::span<const TermCodepoint> line);
+
+    // codepoints
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    int cols() const
+    {
+        return m_cols;
+    }
+
+    /// column x を含む glyph。x >= cols なら {size, cols}
+    TermColumnHit Find(tcb::span<const TermCodepoint> line, int x) const;
+
+    /// column [x, x + width) を描くための span。
+    /// 左端に全角文字がかかる時だけ、はみ出した部分を空白にした copy を
+    /// scratch に作って返す。それ以外は line の一部をそのまま返す
+    tcb::span<TermCodepoint> Slice(tcb::span<TermCodepoint> line, int x,
+                                   int width, TermLine &scratch) const;
+};
+
+} // namespace termgrid
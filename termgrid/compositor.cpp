@@ -0,0 +1,286 @@
+#include "compositor.h"
+#include "encoder.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace termgrid
+{
+
+// merge into a bounding box over this
+static const size_t MAX_DIRTY_RECTS = 16;
+
+TermRect Intersect(const TermRect &a, const TermRect &b)
+{
+    auto left = std::max(a.left, b.left);
+    auto top = std::max(a.top, b.top);
+    auto right = std::min(a.right(), b.right());
+    auto bottom = std::min(a.bottom(), b.bottom());
+    return {left, top, std::max(0, right - left), std::max(0, bottom - top)};
+}
+
+void Subtract(const TermRect &a, const TermRect &b, std::vector<TermRect> &out)
+{
+    auto i = Intersect(a, b);
+    if (i.empty())
+    {
+        out.push_back(a);
+        return;
+    }
+
+    // top
+    if (i.top > a.top)
+    {
+        out.push_back({a.left, a.top, a.width, i.top - a.top});
+    }
+    // bottom
+    if (i.bottom() < a.bottom())
+    {
+        out.push_back({a.left, i.bottom(), a.width, a.bottom() - i.bottom()});
+    }
+    // left
+    if (i.left > a.left)
+    {
+        out.push_back({a.left, i.top, i.left - a.left, i.height});
+    }
+    // right
+    if (i.right() < a.right())
+    {
+        out.push_back({i.right(), i.top, a.right() - i.right(), i.height});
+    }
+}
+
+static bool contains(const TermRect &a, const TermRect &b)
+{
+    return a.left <= b.left && a.top <= b.top && a.right() >= b.right() &&
+           a.bottom() >= b.bottom();
+}
+
+static void add_rect(std::vector<TermRect> &rects, const TermRect &rect)
+{
+    if (rect.empty())
+    {
+        return;
+    }
+    for (auto &r : rects)
+    {
+        if (contains(r, rect))
+        {
+            return;
+        }
+        if (r.left == rect.left && r.width == rect.width &&
+            rect.top <= r.bottom() && r.top <= rect.bottom())
+        {
+            // vertically adjacent rows
+            auto top = std::min(r.top, rect.top);
+            r.height = std::max(r.bottom(), rect.bottom()) - top;
+            r.top = top;
+            return;
+        }
+    }
+    rects.push_back(rect);
+
+    if (rects.size() > MAX_DIRTY_RECTS)
+    {
+        auto box = rects.front();
+        for (auto &r : rects)
+        {
+            auto left = std::min(box.left, r.left);
+            auto top = std::min(box.top, r.top);
+            box = {left, top, std::max(box.right(), r.right()) - left,
+                   std::max(box.bottom(), r.bottom()) - top};
+        }
+        rects.assign(1, box);
+    }
+}
+
+//
+// TermPane
+//
+TermPane::TermPane(const TermRect &rect, int z) : m_rect(rect), m_z(z)
+{
+    Resize({rect.width, rect.height});
+}
+
+TermLine &TermPane::Edit(int y)
+{
+    Invalidate({0, y, m_rect.width, 1});
+    // assigning a line with a version overwrites this
+    m_lines[y].Touch();
+    return m_lines[y];
+}
+
+void TermPane::Invalidate(const TermRect &rect)
+{
+    add_rect(m_dirty, Intersect(rect, {0, 0, m_rect.width, m_rect.height}));
+}
+
+void TermPane::Resize(const TermSize &size)
+{
+    m_rect.width = size.width;
+    m_rect.height = size.height;
+    m_lines.resize(size.height);
+    m_dirty.clear();
+    Invalidate({0, 0, size.width, size.height});
+}
+
+//
+// TermCompositor
+//
+TermCompositor::TermCompositor(const TermSize &size) : m_size(size)
+{
+    Damage({0, 0, size.width, size.height});
+}
+
+void TermCompositor::Resize(const TermSize &size)
+{
+    m_size = size;
+    m_damage.clear();
+    Damage({0, 0, size.width, size.height});
+}
+
+TermPanePtr TermCompositor::AddPane(const TermRect &rect, int z)
+{
+    auto pane = std::make_shared<TermPane>(rect, z);
+    m_panes.push_back(pane);
+    Sort();
+    return pane;
+}
+
+void TermCompositor::RemovePane(const TermPanePtr &pane)
+{
+    auto found = std::find(m_panes.begin(), m_panes.end(), pane);
+    if (found == m_panes.end())
+    {
+        return;
+    }
+    m_panes.erase(found);
+    Damage(pane->m_rect);
+}
+
+void TermCompositor::MovePane(const TermPanePtr &pane, const TermRect &rect)
+{
+    Damage(pane->m_rect);
+    pane->m_rect.left = rect.left;
+    pane->m_rect.top = rect.top;
+    if (rect.width != pane->m_rect.width || rect.height != pane->m_rect.height)
+    {
+        pane->Resize({rect.width, rect.height});
+    }
+    else
+    {
+        pane->Invalidate({0, 0, rect.width, rect.height});
+    }
+}
+
+void TermCompositor::SetZ(const TermPanePtr &pane, int z)
+{
+    if (pane->m_z == z)
+    {
+        return;
+    }
+    pane->m_z = z;
+    Sort();
+    Damage(pane->m_rect);
+}
+
+void TermCompositor::Sort()
+{
+    std::stable_sort(
+        m_panes.begin(), m_panes.end(),
+        [](const TermPanePtr &l, const TermPanePtr &r) { return l->m_z < r->m_z; });
+}
+
+void TermCompositor::Damage(const TermRect &rect)
+{
+    add_rect(m_damage, Intersect(rect, {0, 0, m_size.width, m_size.height}));
+}
+
+// rect (screen) in the screen minus panes over index
+void TermCompositor::Visible(size_t index, const TermRect &rect,
+                             std::vector<TermRect> &out) const
+{
+    out.clear();
+    // panes may be partly off screen
+    auto clipped = Intersect(rect, {0, 0, m_size.width, m_size.height});
+    if (clipped.empty())
+    {
+        return;
+    }
+    out.push_back(clipped);
+    std::vector<TermRect> tmp;
+    for (auto i = index; i < m_panes.size() && !out.empty(); ++i)
+    {
+        tmp.clear();
+        for (auto &r : out)
+        {
+            Subtract(r, m_panes[i]->m_rect, tmp);
+        }
+        out.swap(tmp);
+    }
+}
+
+void TermCompositor::Render(std::string &out, const TermcapEntryPtr &entry)
+{
+    TERMGRID_TRACE_SCOPE("compositor.render");
+    // spread exposed area to panes under it
+    std::vector<TermRect> visible;
+    for (auto &damage : m_damage)
+    {
+        for (auto &pane : m_panes)
+        {
+            auto i = Intersect(damage, pane->m_rect);
+            if (!i.empty())
+            {
+                pane->Invalidate({i.left - pane->m_rect.left,
+                                  i.top - pane->m_rect.top, i.width, i.height});
+            }
+        }
+
+        // background
+        Visible(0, damage, visible);
+        for (auto &r : visible)
+        {
+            for (int y = r.top; y < r.bottom(); ++y)
+            {
+                entry->cursor_xy(out, r.left, y);
+                out.append(r.width, ' ');
+            }
+        }
+    }
+    m_damage.clear();
+
+    for (size_t i = 0; i < m_panes.size(); ++i)
+    {
+        auto &pane = *m_panes[i];
+        auto &rect = pane.m_rect;
+        for (auto &dirty : pane.m_dirty)
+        {
+            Visible(i + 1,
+                    {rect.left + dirty.left, rect.top + dirty.top, dirty.width,
+                     dirty.height},
+                    visible);
+            for (auto &r : visible)
+            {
+                for (int y = r.top; y < r.bottom(); ++y)
+                {
+                    entry->cursor_xy(out, r.left, y);
+                    auto &line = pane.m_lines[y - rect.top];
+                    if (!line.version)
+                    {
+                        // changed by clear or push after Edit
+                        line.Touch();
+                    }
+                    m_cache.Emit(out, line.version, r.left - rect.left, r.width,
+                                 [&line, &r, &rect](std::string &out) {
+                                     EncodeLineRange(out, line.codes,
+                                                     r.left - rect.left,
+                                                     r.width);
+                                 });
+                }
+            }
+        }
+        pane.m_dirty.clear();
+    }
+}
+
+} // namespace termgrid
@@ -0,0 +1,98 @@
+#pragma once
+#include "line_cache.h"
+#include "termcap_entry.h"
+#include "termgrid.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace termgrid
+{
+
+TermRect Intersect(const TermRect &a, const TermRect &b);
+
+/// a から b を引いた残りを最大 4 個の矩形にして out に追加する
+void Subtract(const TermRect &a, const TermRect &b, std::vector<TermRect> &out);
+
+/// 自前の行を持つ矩形の layer。
+/// 書き換えた範囲を pane 座標の dirty rect として記録する。
+class TermPane
+{
+    friend class TermCompositor;
+
+    TermRect m_rect;
+    int m_z;
+    std::vector<TermLine> m_lines;
+    std::vector<TermRect> m_dirty;
+
+public:
+    TermPane(const TermRect &rect, int z);
+
+    const TermRect &rect() const
+    {
+        return m_rect;
+    }
+    int z() const
+    {
+        return m_z;
+    }
+
+    const TermLine &Line(int y) const
+    {
+        return m_lines[y];
+    }
+
+    // mark row y dirty and return it for update. the line gets a new version
+    TermLine &Edit(int y);
+
+    // pane local
+    void Invalidate(const TermRect &rect);
+
+    bool IsDirty() const
+    {
+        return !m_dirty.empty();
+    }
+
+private:
+    void Resize(const TermSize &size);
+};
+using TermPanePtr = std::shared_ptr<TermPane>;
+
+/// z 順に pane を画面に合成する。
+/// Render は各 pane の dirty rect のうち上の pane に隠れていない部分だけを encode する。
+class TermCompositor
+{
+    TermSize m_size;
+    // sorted by z. back is top
+    std::vector<TermPanePtr> m_panes;
+    // screen area exposed by move/remove. redraw what is under it
+    std::vector<TermRect> m_damage;
+    // pane lines moved or exposed again are not encoded again
+    EncodedLineCache m_cache;
+
+public:
+    TermCompositor(const TermSize &size);
+
+    void Resize(const TermSize &size);
+
+    TermPanePtr AddPane(const TermRect &rect, int z = 0);
+    void RemovePane(const TermPanePtr &pane);
+    void MovePane(const TermPanePtr &pane, const TermRect &rect);
+    void SetZ(const TermPanePtr &pane, int z);
+
+    // append escape sequences for all dirty visible areas and clear dirty
+    void Render(std::string &out, const TermcapEntryPtr &entry);
+
+    const EncodedLineCache &cache() const
+    {
+        return m_cache;
+    }
+
+private:
+    void Sort();
+    void Damage(const TermRect &rect);
+    void Visible(size_t index, const TermRect &rect,
+                 std::vector<TermRect> &out) const;
+};
+
+} // namespace termgrid
@@ -0,0 +1,221 @@
+#include "encoder.h"
+#include "sgr.h"
+#include "trace.h"
+#include <atomic>
+
+namespace termgrid
+{
+
+void EncodeLine(std::string &out, tcb::span<const TermCodepoint> line,
+                int width)
+{
+    detail::encode_cells(out, line.data(), line.data() + line.size(), width);
+}
+
+void EncodeStyledLine(std::string &out, const StyledLine &line,
+                      const TermStyleTable &table, int width)
+{
+    detail::encode_runs(out, line, table, width);
+}
+
+void EncodeLineRange(std::string &out, tcb::span<const TermCodepoint> line,
+                     int x, int width)
+{
+    auto p = line.data();
+    auto end = p + line.size();
+    int col = 0;
+    int written = 0;
+    for (; p != end && col < x; ++p)
+    {
+        col += p->cols;
+    }
+    if (col > x)
+    {
+        // wide char straddles the left edge
+        written = std::min(col - x, width);
+        out.append(written, ' ');
+    }
+    for (; p != end && p->cols == 0; ++p)
+    {
+        // combining of skipped glyph
+    }
+
+    written += detail::encode_cells(out, p, end, width - written);
+    if (written < width)
+    {
+        out.append(width - written, ' ');
+    }
+}
+
+void RenderBlit(std::string &out, const TermcapEntryPtr &entry,
+                const GetLineFunc &getLine, const TermPoint &src,
+                const TermSize &size, const TermPoint &dst)
+{
+    TERMGRID_TRACE_SCOPE("encode");
+    for (int y = 0; y < size.height; ++y)
+    {
+        entry->cursor_xy(out, dst.x, dst.y + y);
+        auto line = getLine({src.x, src.y + y});
+        EncodeLine(out, line, size.width);
+        entry->clear_to_eol(out);
+    }
+}
+
+//
+// ParallelEncoder
+//
+static const int ROWS_PER_TASK = 4;
+
+ParallelEncoder::ParallelEncoder(int threads, size_t threshold)
+    : m_pool(threads), m_threshold(threshold)
+{
+    m_arenas.resize(m_pool.size());
+}
+
+void ParallelEncoder::Encode(const TermcapEntryPtr &entry,
+                             const GetLineFunc &getLine, const TermPoint &src,
+                             const TermSize &size, const TermPoint &dst)
+{
+    Encode(
+        entry,
+        [&getLine](const TermPoint &p) { return TermLineRef{getLine(p)}; },
+        src, size, dst);
+}
+
+void ParallelEncoder::Encode(const TermcapEntryPtr &entry,
+                             const GetLineRefFunc &getLine,
+                             const TermPoint &src, const TermSize &size,
+                             const TermPoint &dst)
+{
+    TERMGRID_TRACE_SCOPE("encode");
+    m_x = src.x;
+    m_width = size.width;
+    m_rows.clear();
+    m_versions.clear();
+    m_prefix.clear();
+    m_prefixOffsets.clear();
+    {
+        // rows from the line source
+        TERMGRID_TRACE_SCOPE("layout");
+        for (int y = 0; y < size.height; ++y)
+        {
+            m_prefixOffsets.push_back(m_prefix.size());
+            entry->cursor_xy(m_prefix, dst.x, dst.y + y);
+            auto line = getLine({src.x, src.y + y});
+            m_rows.push_back(line.codes);
+            m_versions.push_back(line.version);
+        }
+        m_prefixOffsets.push_back(m_prefix.size());
+        m_eol.clear();
+        entry->clear_to_eol(m_eol);
+    }
+
+    for (auto &arena : m_arenas)
+    {
+        // keep capacity
+        arena.clear();
+    }
+    m_fragments.resize(m_rows.size());
+
+    // cache lookup on this thread. hits are copied before the workers start
+    m_misses.clear();
+    size_t cells = 0;
+    for (int row = 0; row < (int)m_rows.size(); ++row)
+    {
+        if (m_versions[row])
+        {
+            if (auto bytes = m_cache.Find(m_versions[row], m_x, m_width))
+            {
+                auto &arena = m_arenas[0];
+                m_fragments[row] = {0, arena.size(), bytes->size()};
+                arena.append(*bytes);
+                continue;
+            }
+        }
+        m_misses.push_back(row);
+        cells += m_rows[row].size();
+    }
+
+    int misses = (int)m_misses.size();
+    if (cells < m_threshold || m_pool.size() == 1)
+    {
+        for (int i = 0; i < misses; ++i)
+        {
+            EncodeRow(0, m_misses[i]);
+        }
+    }
+    else
+    {
+        std::atomic<int> next = 0;
+        m_pool.Run([this, misses, &next](int worker) {
+            while (true)
+            {
+                auto begin = next.fetch_add(ROWS_PER_TASK);
+                if (begin >= misses)
+                {
+                    break;
+                }
+                auto end = std::min(begin + ROWS_PER_TASK, misses);
+                TERMGRID_TRACE_SCOPE("encode.rows");
+                for (int i = begin; i < end; ++i)
+                {
+                    EncodeRow(worker, m_misses[i]);
+                }
+            }
+        });
+    }
+
+    for (auto row : m_misses)
+    {
+        if (m_versions[row])
+        {
+            auto body = Body(row);
+            m_cache.Store(m_versions[row], m_x, m_width,
+                          {body.data(), body.size()});
+        }
+    }
+}
+
+void ParallelEncoder::EncodeRow(int worker, int row)
+{
+    auto &arena = m_arenas[worker];
+    auto offset = arena.size();
+    EncodeLine(arena, m_rows[row], m_width);
+    m_fragments[row] = {worker, offset, arena.size() - offset};
+}
+
+tcb::span<const char> ParallelEncoder::Prefix(int row) const
+{
+    auto begin = m_prefixOffsets[row];
+    return {m_prefix.data() + begin, m_prefixOffsets[row + 1] - begin};
+}
+
+tcb::span<const char> ParallelEncoder::Body(int row) const
+{
+    auto &f = m_fragments[row];
+    return {m_arenas[f.worker].data() + f.offset, f.size};
+}
+
+size_t ParallelEncoder::size() const
+{
+    auto size = m_prefix.size() + m_eol.size() * m_rows.size();
+    for (auto &f : m_fragments)
+    {
+        size += f.size;
+    }
+    return size;
+}
+
+void ParallelEncoder::CopyTo(std::string &out) const
+{
+    for (int row = 0; row < (int)m_rows.size(); ++row)
+    {
+        auto prefix = Prefix(row);
+        out.append(prefix.data(), prefix.size());
+        auto body = Body(row);
+        out.append(body.data(), body.size());
+        out.append(m_eol);
+    }
+}
+
+} // namespace termgrid
@@ -0,0 +1,103 @@
+#pragma once
+#include "line_cache.h"
+#include "style.h"
+#include "termcap_entry.h"
+#include "termgrid.h"
+#include "worker_pool.h"
+#include <string>
+
+namespace termgrid
+{
+
+using GetLineFunc =
+    std::function<tcb::span<TermCodepoint>(const TermPoint &)>;
+
+/// 行の cells と元の TermLine::version。version 0 は cache しない
+struct TermLineRef
+{
+    tcb::span<TermCodepoint> codes;
+    uint64_t version = 0;
+};
+using GetLineRefFunc = std::function<TermLineRef(const TermPoint &)>;
+
+/// line の先頭から width columns 分を utf-8 と SGR にして out に追記する。
+/// 既定の属性で始まり既定の属性に戻して終わるので、行ごとに独立して encode できる。
+void EncodeLine(std::string &out, tcb::span<const TermCodepoint> line,
+                int width);
+
+/// EncodeLine の StyledLine 版。SGR は style id が変わる run の境目でだけ出す
+void EncodeStyledLine(std::string &out, const StyledLine &line,
+                      const TermStyleTable &table, int width);
+
+/// line の column [x, x + width) を encode する。
+/// 範囲の端にかかる全角文字は空白にし、足りない分も空白で埋める。
+/// clear_to_eol で他の領域を消せない pane 用。
+void EncodeLineRange(std::string &out, tcb::span<const TermCodepoint> line,
+                     int x, int width);
+
+/// src から size 分の行を dst に描画する byte 列を out に追記する
+void RenderBlit(std::string &out, const TermcapEntryPtr &entry,
+                const GetLineFunc &getLine, const TermPoint &src,
+                const TermSize &size, const TermPoint &dst);
+
+/// RenderBlit と同じ byte 列を worker pool で行ごとに並列に encode する。
+///
+/// 各 worker は自分の arena に行の fragment を書き、
+/// CopyTo で行順に 1 つの frame にする。
+/// version のある行は (version, src.x, width) で encode 結果を cache し、
+/// scroll で前の frame にあった行は encode せずに copy する。
+class ParallelEncoder
+{
+    struct Fragment
+    {
+        int worker;
+        size_t offset;
+        size_t size;
+    };
+
+    WorkerPool m_pool;
+    // cells per frame below this are encoded on the calling thread
+    size_t m_threshold;
+    std::vector<std::string> m_arenas;
+    std::vector<Fragment> m_fragments;
+    std::vector<tcb::span<TermCodepoint>> m_rows;
+    std::vector<uint64_t> m_versions;
+    // rows not in the cache
+    std::vector<int> m_misses;
+    EncodedLineCache m_cache;
+    int m_x = 0;
+    int m_width = 0;
+    // cursor_xy for each row. tgoto is not thread safe
+    std::string m_prefix;
+    std::vector<size_t> m_prefixOffsets;
+    std::string m_eol;
+
+public:
+    ParallelEncoder(int threads = 0, size_t threshold = 8192);
+
+    void Encode(const TermcapEntryPtr &entry, const GetLineRefFunc &getLine,
+                const TermPoint &src, const TermSize &size,
+                const TermPoint &dst);
+
+    // without versions. encodes every row
+    void Encode(const TermcapEntryPtr &entry, const GetLineFunc &getLine,
+                const TermPoint &src, const TermSize &size,
+                const TermPoint &dst);
+
+    const EncodedLineCache &cache() const
+    {
+        return m_cache;
+    }
+
+    // encoded bytes
+    size_t size() const;
+
+    void CopyTo(std::string &out) const;
+
+private:
+    void EncodeRow(int worker, int row);
+    tcb::span<const char> Prefix(int row) const;
+    tcb::span<const char> Body(int row) const;
+};
+
+} // namespace termgrid
@@ -0,0 +1,351 @@
+#include "file_lines.h"
+#include <climits>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace termgrid
+{
+
+// sparse line index
+static const int64_t STRIDE = 64;
+// bytes per indexer step
+static const size_t SCAN_CHUNK = 4 * 1024 * 1024;
+// longer lines are cut
+static const size_t MAX_DECODE_BYTES = 64 * 1024;
+static const size_t CACHE_SLOTS = 1024;
+static const int TAB_COLS = 8;
+
+// count '\n' in [begin, end) and record start of every STRIDE-th line
+static int64_t scan_newlines(const char *data, size_t begin, size_t end,
+                             int64_t newlines, std::vector<uint64_t> &out)
+{
+    auto p = begin;
+#ifdef __SSE2__
+    auto nl = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16)
+    {
+        auto v = _mm_loadu_si128((const __m128i *)(data + p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if (!mask)
+        {
+            continue;
+        }
+        auto count = __builtin_popcount(mask);
+        if ((newlines % STRIDE) + count < STRIDE)
+        {
+            // no checkpoint in this block
+            newlines += count;
+            continue;
+        }
+        for (; mask; mask &= mask - 1)
+        {
+            if (++newlines % STRIDE == 0)
+            {
+                out.push_back(p + __builtin_ctz(mask) + 1);
+            }
+        }
+    }
+#endif
+    for (; p < end; ++p)
+    {
+        if (data[p] == '\n')
+        {
+            if (++newlines % STRIDE == 0)
+            {
+                out.push_back(p + 1);
+            }
+        }
+    }
+    return newlines;
+}
+
+FileLineSource::FileLineSource(int fd, const char *data, size_t size,
+                               const TermLine::GetColsFunc &getCols)
+    : m_fd(fd), m_data(data), m_size(size), m_getCols(getCols),
+      m_cache(CACHE_SLOTS)
+{
+    m_checkpoints.push_back(0);
+    m_indexer = std::thread(&FileLineSource::Index, this);
+}
+
+FileLineSource::~FileLineSource()
+{
+    m_quit = true;
+    m_indexer.join();
+    if (m_data)
+    {
+        munmap((void *)m_data, m_size);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+std::shared_ptr<FileLineSource>
+FileLineSource::open(const char *path, const TermLine::GetColsFunc &getCols)
+{
+    auto fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    const char *data = nullptr;
+    if (st.st_size > 0)
+    {
+        auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+        data = (const char *)p;
+    }
+
+    return std::make_shared<FileLineSource>(fd, data, st.st_size, getCols);
+}
+
+void FileLineSource::Index()
+{
+    if (m_data)
+    {
+        madvise((void *)m_data, m_size, MADV_SEQUENTIAL);
+    }
+
+    int64_t newlines = 0;
+    std::vector<uint64_t> checkpoints;
+    for (size_t pos = 0; pos < m_size && !m_quit; pos += SCAN_CHUNK)
+    {
+        auto end = std::min(pos + SCAN_CHUNK, m_size);
+        checkpoints.clear();
+        newlines = scan_newlines(m_data, pos, end, newlines, checkpoints);
+
+        // publish
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_checkpoints.insert(m_checkpoints.end(), checkpoints.begin(),
+                             checkpoints.end());
+        m_newlines = newlines;
+    }
+    m_complete = !m_quit;
+}
+
+int64_t FileLineSource::IndexedLines() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_complete && m_size > 0 && m_data[m_size - 1] != '\n')
+    {
+        // last line without '\n'
+        return m_newlines + 1;
+    }
+    return m_newlines;
+}
+
+bool FileLineSource::LineRange(int64_t index, size_t *begin,
+                               size_t *end) const
+{
+    if (index < 0 || index >= IndexedLines())
+    {
+        return false;
+    }
+
+    size_t p;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        p = m_checkpoints[index / STRIDE];
+    }
+    for (auto i = index % STRIDE; i > 0; --i)
+    {
+        auto nl = (const char *)memchr(m_data + p, '\n', m_size - p);
+        p = nl - m_data + 1;
+    }
+    *begin = p;
+    auto nl = (const char *)memchr(m_data + p, '\n', m_size - p);
+    *end = nl ? nl - m_data : m_size;
+    return true;
+}
+
+bool FileLineSource::TailLineRange(int64_t index, size_t *begin, size_t *end)
+{
+    if (index < 0)
+    {
+        return false;
+    }
+
+    if (m_tailStarts.empty())
+    {
+        if (m_size == 0)
+        {
+            return false;
+        }
+        // skip the last '\n'
+        auto last = m_data[m_size - 1] == '\n' ? m_size - 1 : m_size;
+        auto nl = (const char *)memrchr(m_data, '\n', last);
+        m_tailStarts.push_back(nl ? nl - m_data + 1 : 0);
+    }
+
+    while ((int64_t)m_tailStarts.size() <= index)
+    {
+        auto start = m_tailStarts.back();
+        if (start == 0)
+        {
+            // top of file
+            return false;
+        }
+        auto nl = (const char *)memrchr(m_data, '\n', start - 1);
+        m_tailStarts.push_back(nl ? nl - m_data + 1 : 0);
+    }
+
+    *begin = m_tailStarts[index];
+    if (index == 0)
+    {
+        *end = m_data[m_size - 1] == '\n' ? m_size - 1 : m_size;
+    }
+    else
+    {
+        *end = m_tailStarts[index - 1] - 1;
+    }
+    return true;
+}
+
+int64_t FileLineSource::TailLines(int64_t limit)
+{
+    size_t begin, end;
+    if (limit <= 0 || !TailLineRange(0, &begin, &end))
+    {
+        return 0;
+    }
+    if (TailLineRange(limit - 1, &begin, &end))
+    {
+        return limit;
+    }
+    // stopped at the top of file
+    return m_tailStarts.size();
+}
+
+tcb::span<TermCodepoint> FileLineSource::GetLine(int64_t index)
+{
+    size_t begin, end;
+    if (!LineRange(index, &begin, &end))
+    {
+        return {};
+    }
+    return Decode(index, begin, end);
+}
+
+tcb::span<TermCodepoint> FileLineSource::GetTailLine(int64_t index)
+{
+    size_t begin, end;
+    if (!TailLineRange(index, &begin, &end))
+    {
+        return {};
+    }
+    return Decode(~index, begin, end);
+}
+
+// return 0 if invalid
+static int utf8_length(const uint8_t *p, size_t remain)
+{
+    int len;
+    if (p[0] < 0x80)
+    {
+        return 1;
+    }
+    else if ((p[0] & 0xE0) == 0xC0)
+    {
+        len = 2;
+    }
+    else if ((p[0] & 0xF0) == 0xE0)
+    {
+        len = 3;
+    }
+    else if ((p[0] & 0xF8) == 0xF0)
+    {
+        len = 4;
+    }
+    else
+    {
+        return 0;
+    }
+    if (remain < (size_t)len)
+    {
+        return 0;
+    }
+    for (int i = 1; i < len; ++i)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+    return len;
+}
+
+tcb::span<TermCodepoint> FileLineSource::Decode(int64_t key, size_t begin,
+                                                size_t end)
+{
+    auto &slot = m_cache[(uint64_t)key % CACHE_SLOTS];
+    if (slot.key == key)
+    {
+        return slot.line.codes;
+    }
+    slot.key = key;
+    auto &l = slot.line;
+    l.clear();
+
+    end = std::min(end, begin + MAX_DECODE_BYTES);
+    auto p = (const uint8_t *)m_data + begin;
+    auto e = (const uint8_t *)m_data + end;
+    int x = 0;
+    while (p < e)
+    {
+        if (*p == '\t')
+        {
+            auto n = TAB_COLS - x % TAB_COLS;
+            for (auto &c : l.push(std::string_view("        ", n)))
+            {
+                c.cols = 1;
+            }
+            x += n;
+            ++p;
+            continue;
+        }
+        if (*p < 0x20 || *p == 0x7F)
+        {
+            // \r and other controls
+            ++p;
+            continue;
+        }
+
+        auto len = utf8_length(p, e - p);
+        if (!len)
+        {
+            auto &c = l.push(u8"�")[0];
+            c.cols = 1;
+            x += 1;
+            ++p;
+            continue;
+        }
+        auto &c = l.push((const char8_t *)p, len)[0];
+        c.cols = std::max(0, m_getCols(c.cp.to_unicode()));
+        x += c.cols;
+        p += len;
+    }
+
+    return l.codes;
+}
+
+} // namespace termgrid
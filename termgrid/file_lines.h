@@ -0,0 +1,83 @@
+#pragma once
+#include "termgrid.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace termgrid
+{
+
+/// mmap したファイルを行単位で TermLine にする line source。
+///
+/// 改行の index は background thread で先頭から作られ、作れた所まで順に使える。
+/// 末尾からの行は index を待たずに後ろから探す。
+/// TermLine への decode は要求された行だけ。
+class FileLineSource
+{
+    int m_fd = -1;
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    TermLine::GetColsFunc m_getCols;
+
+    // start offset of every STRIDE-th line
+    mutable std::mutex m_mutex;
+    std::vector<uint64_t> m_checkpoints;
+    // lines terminated by '\n' so far
+    int64_t m_newlines = 0;
+    std::atomic<bool> m_complete = false;
+    std::atomic<bool> m_quit = false;
+    std::thread m_indexer;
+
+    // start offset of lines from end. [0] is the last line
+    std::vector<uint64_t> m_tailStarts;
+
+    struct Slot
+    {
+        int64_t key = INT64_MIN;
+        TermLine line;
+    };
+    std::vector<Slot> m_cache;
+
+public:
+    FileLineSource(int fd, const char *data, size_t size,
+                   const TermLine::GetColsFunc &getCols);
+    ~FileLineSource();
+    FileLineSource(const FileLineSource &) = delete;
+    FileLineSource &operator=(const FileLineSource &) = delete;
+
+    static std::shared_ptr<FileLineSource>
+    open(const char *path, const TermLine::GetColsFunc &getCols);
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool IsIndexComplete() const
+    {
+        return m_complete;
+    }
+
+    // lines available from the top
+    int64_t IndexedLines() const;
+
+    // empty if not indexed yet
+    tcb::span<TermCodepoint> GetLine(int64_t index);
+
+    // 0 is the last line. does not wait for index
+    tcb::span<TermCodepoint> GetTailLine(int64_t index);
+
+    // lines from the end up to limit. less than limit at the top of file
+    int64_t TailLines(int64_t limit);
+
+private:
+    void Index();
+    bool LineRange(int64_t index, size_t *begin, size_t *end) const;
+    bool TailLineRange(int64_t index, size_t *begin, size_t *end);
+    tcb::span<TermCodepoint> Decode(int64_t key, size_t begin, size_t end);
+};
+using FileLineSourcePtr = std::shared_ptr<FileLineSource>;
+
+} // namespace termgrid
@@ -0,0 +1,278 @@
+#include "input.h"
+#include "trace.h"
+
+namespace termgrid
+{
+
+const std::string_view PASTE_BEGIN = "\033[200~";
+const std::string_view PASTE_END = "\033[201~";
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// ESC [ < Cb ; Cx ; Cy (M|m)
+static bool parse_sgr_mouse(std::string_view params, char final,
+                            MouseEvent &mouse)
+{
+    int values[3] = {0, 0, 0};
+    int i = 0;
+    for (auto c : params)
+    {
+        if (c == ';')
+        {
+            if (++i >= 3)
+            {
+                return false;
+            }
+        }
+        else if (is_digit(c))
+        {
+            values[i] = values[i] * 10 + c - '0';
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (i != 2)
+    {
+        return false;
+    }
+
+    auto cb = values[0];
+    mouse.x = values[1] - 1;
+    mouse.y = values[2] - 1;
+    mouse.modifiers = cb & 0x1C;
+    mouse.wheel = 0;
+    mouse.count = 1;
+    auto button = cb & 3;
+    if (cb & 64)
+    {
+        mouse.action = MouseActions::Wheel;
+        mouse.button = -1;
+        // 64: up, 65: down
+        mouse.wheel = (button & 1) ? 1 : -1;
+    }
+    else if (cb & 32)
+    {
+        mouse.action = button == 3 ? MouseActions::Motion : MouseActions::Drag;
+        mouse.button = button == 3 ? -1 : button;
+    }
+    else
+    {
+        mouse.action = final == 'M' ? MouseActions::Press : MouseActions::Release;
+        mouse.button = button;
+    }
+    return true;
+}
+
+static void push_key(std::vector<InputEvent> &events, int key)
+{
+    events.push_back({InputTypes::Key, key, {}, {}, false});
+}
+
+size_t InputDecoder::DecodeEscape(std::string_view data,
+                                  std::vector<InputEvent> &events)
+{
+    if (data.size() == 1)
+    {
+        // a full read may end on the ESC of the next sequence.
+        // FlushEscape makes it the ESC key
+        return 0;
+    }
+
+    if (data[1] != '[' && data[1] != 'O')
+    {
+        // ESC + key
+        push_key(events, 0x1b);
+        return 1;
+    }
+
+    // CSI: parameter bytes, intermediate bytes, final byte
+    size_t i = 2;
+    for (; i < data.size(); ++i)
+    {
+        auto c = (unsigned char)data[i];
+        if (c >= 0x40 && c <= 0x7E && !(i == 2 && c == '<'))
+        {
+            break;
+        }
+    }
+    if (i >= data.size())
+    {
+        // incomplete
+        return 0;
+    }
+
+    auto final = data[i];
+    auto params = data.substr(2, i - 2);
+    if (params.size() && params[0] == '<' && (final == 'M' || final == 'm'))
+    {
+        MouseEvent mouse;
+        if (parse_sgr_mouse(params.substr(1), final, mouse))
+        {
+            events.push_back({InputTypes::Mouse, 0, mouse, {}, false});
+        }
+        return i + 1;
+    }
+
+    if (final == '~' && params == "200")
+    {
+        m_paste = true;
+        return i + 1;
+    }
+
+    switch (final)
+    {
+    case 'A':
+        push_key(events, TermKeys_Up);
+        break;
+    case 'B':
+        push_key(events, TermKeys_Down);
+        break;
+    case 'C':
+        push_key(events, TermKeys_Right);
+        break;
+    case 'D':
+        push_key(events, TermKeys_Left);
+        break;
+    case 'H':
+        push_key(events, TermKeys_Home);
+        break;
+    case 'F':
+        push_key(events, TermKeys_End);
+        break;
+    default:
+        // unknown sequence is dropped
+        break;
+    }
+    return i + 1;
+}
+
+size_t InputDecoder::DecodePaste(std::string_view data,
+                                 std::vector<InputEvent> &events)
+{
+    auto end = data.find(PASTE_END);
+    if (end != std::string_view::npos)
+    {
+        events.push_back({InputTypes::Paste, 0, {}, data.substr(0, end), true});
+        m_paste = false;
+        return end + PASTE_END.size();
+    }
+
+    // PASTE_END may be split by read
+    auto size = data.size();
+    for (size_t n = std::min(size, PASTE_END.size() - 1); n > 0; --n)
+    {
+        if (data.substr(size - n) == PASTE_END.substr(0, n))
+        {
+            size -= n;
+            break;
+        }
+    }
+    if (size)
+    {
+        events.push_back({InputTypes::Paste, 0, {}, data.substr(0, size), false});
+    }
+    return size;
+}
+
+void InputDecoder::Feed(std::string_view data, std::vector<InputEvent> &events)
+{
+    TERMGRID_TRACE_SCOPE("input.decode");
+    m_buffer.clear();
+    if (m_pending.size())
+    {
+        m_pending.append(data);
+        m_buffer.swap(m_pending);
+        data = m_buffer;
+    }
+
+    size_t i = 0;
+    while (i < data.size())
+    {
+        if (m_paste)
+        {
+            auto n = DecodePaste(data.substr(i), events);
+            if (n == 0)
+            {
+                break;
+            }
+            i += n;
+            continue;
+        }
+
+        auto c = (unsigned char)data[i];
+        if (c != 0x1b)
+        {
+            push_key(events, c);
+            ++i;
+            continue;
+        }
+
+        auto n = DecodeEscape(data.substr(i), events);
+        if (n == 0)
+        {
+            break;
+        }
+        i += n;
+    }
+
+    // keep incomplete sequence
+    m_pending.assign(data.substr(i));
+}
+
+void InputDecoder::FlushEscape(std::vector<InputEvent> &events)
+{
+    if (!m_paste && m_pending == "\033")
+    {
+        push_key(events, 0x1b);
+        m_pending.clear();
+    }
+}
+
+static bool mergeable(const MouseEvent &l, const MouseEvent &r)
+{
+    if (l.action != r.action || l.modifiers != r.modifiers ||
+        l.button != r.button)
+    {
+        return false;
+    }
+    switch (l.action)
+    {
+    case MouseActions::Motion:
+    case MouseActions::Drag:
+        return true;
+    case MouseActions::Wheel:
+        // same direction
+        return (l.wheel > 0) == (r.wheel > 0);
+    default:
+        return false;
+    }
+}
+
+void CoalesceEvents(std::vector<InputEvent> &events)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        auto &e = events[i];
+        if (out > 0 && e.type == InputTypes::Mouse &&
+            events[out - 1].type == InputTypes::Mouse &&
+            mergeable(events[out - 1].mouse, e.mouse))
+        {
+            auto &merged = events[out - 1].mouse;
+            merged.x = e.mouse.x;
+            merged.y = e.mouse.y;
+            merged.wheel += e.mouse.wheel;
+            merged.count += e.mouse.count;
+            continue;
+        }
+        events[out++] = e;
+    }
+    events.resize(out);
+}
+
+} // namespace termgrid
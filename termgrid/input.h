@@ -0,0 +1,112 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace termgrid
+{
+
+// any motion tracking + SGR(1006) coordinates
+constexpr std::string_view MOUSE_ENABLE = "\033[?1003h\033[?1006h";
+constexpr std::string_view MOUSE_DISABLE = "\033[?1006l\033[?1003l";
+// bracketed paste
+constexpr std::string_view PASTE_ENABLE = "\033[?2004h";
+constexpr std::string_view PASTE_DISABLE = "\033[?2004l";
+
+/// InputEvent::key for escape sequences. beyond unicode
+enum TermKeys : int
+{
+    TermKeys_Up = 0x110000,
+    TermKeys_Down,
+    TermKeys_Right,
+    TermKeys_Left,
+    TermKeys_Home,
+    TermKeys_End,
+};
+
+enum class InputTypes
+{
+    Key,
+    Mouse,
+    // bracketed paste. not keystrokes
+    Paste,
+};
+
+enum class MouseActions
+{
+    Press,
+    Release,
+    // moved with button
+    Drag,
+    // moved without button
+    Motion,
+    Wheel,
+};
+
+enum class MouseModifiers : int
+{
+    None = 0,
+    Shift = 0x04,
+    Meta = 0x08,
+    Control = 0x10,
+};
+
+struct MouseEvent
+{
+    MouseActions action;
+    // 0: left, 1: middle, 2: right. -1 for Motion
+    int button;
+    // 0 origin
+    int x;
+    int y;
+    int modifiers;
+    // Wheel: lines. + is down
+    int wheel;
+    // reports merged into this
+    int count;
+};
+
+struct InputEvent
+{
+    InputTypes type;
+    // byte or TermKeys
+    int key;
+    MouseEvent mouse;
+    // Paste: chunk of the pasted text. points into the data given to Feed or
+    // the decoder buffer, valid until the next Feed. long paste comes as
+    // chunks of each read
+    std::string_view text;
+    // Paste: last chunk
+    bool pasteEnd;
+};
+
+/// tty から読んだ byte 列を InputEvent にする。
+/// 途中で切れた escape sequence は次の Feed まで持ち越す。
+/// read の末尾の ESC も持ち越すので、ESC key にするには FlushEscape を呼ぶ。
+/// paste 中の byte は解釈せずに read buffer を指す Paste event にする。
+class InputDecoder
+{
+    std::string m_pending;
+    // keep data of the last Feed alive for Paste::text
+    std::string m_buffer;
+    bool m_paste = false;
+
+public:
+    void Feed(std::string_view data, std::vector<InputEvent> &events);
+
+    /// 持ち越した ESC だけを ESC key にする。
+    /// read が buffer を満たさなかったとき (続きが来ていない) に呼ぶ
+    void FlushEscape(std::vector<InputEvent> &events);
+
+private:
+    // return consumed bytes. 0 if incomplete
+    size_t DecodeEscape(std::string_view data, std::vector<InputEvent> &events);
+    // return consumed bytes
+    size_t DecodePaste(std::string_view data, std::vector<InputEvent> &events);
+};
+
+/// 連続する Motion, Drag と同じ向きの Wheel を 1 つにまとめる。
+/// 1 回の read (1 frame) 分の event に使う。
+void CoalesceEvents(std::vector<InputEvent> &events);
+
+} // namespace termgrid
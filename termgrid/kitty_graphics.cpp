@@ -0,0 +1,373 @@
+#include "kitty_graphics.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace termgrid
+{
+
+// payload chunk of direct transfer. multiple of 4
+static const size_t CHUNK_SIZE = 4096;
+// image id of AppendQuery. a=q stores nothing
+static const uint32_t QUERY_IMAGE = 0x7fffffff;
+
+static const char BASE64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void append_base64(std::string &out, const uint8_t *p, size_t size)
+{
+    auto end = p + size / 3 * 3;
+    for (; p != end; p += 3)
+    {
+        uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+        out.push_back(BASE64[(v >> 18) & 63]);
+        out.push_back(BASE64[(v >> 12) & 63]);
+        out.push_back(BASE64[(v >> 6) & 63]);
+        out.push_back(BASE64[v & 63]);
+    }
+    switch (size % 3)
+    {
+    case 1:
+    {
+        uint32_t v = p[0] << 16;
+        out.push_back(BASE64[(v >> 18) & 63]);
+        out.push_back(BASE64[(v >> 12) & 63]);
+        out.append("==");
+        break;
+    }
+    case 2:
+    {
+        uint32_t v = (p[0] << 16) | (p[1] << 8);
+        out.push_back(BASE64[(v >> 18) & 63]);
+        out.push_back(BASE64[(v >> 12) & 63]);
+        out.push_back(BASE64[(v >> 6) & 63]);
+        out.push_back('=');
+        break;
+    }
+    }
+}
+
+static void append_command(std::string &out, std::string_view keys,
+                           std::string_view payload = {})
+{
+    out.append("\033_G");
+    out.append(keys);
+    if (payload.size())
+    {
+        out.push_back(';');
+        out.append(payload);
+    }
+    out.append("\033\\");
+}
+
+// delete a placement. d=i: keep image data
+static void append_delete(std::string &out, uint32_t image, uint32_t placement)
+{
+    append_command(out, "a=d,d=i,q=2,i=" + std::to_string(image) +
+                            ",p=" + std::to_string(placement));
+}
+
+static bool write_all(int fd, const uint8_t *p, size_t size)
+{
+    while (size)
+    {
+        auto n = write(fd, p, size);
+        if (n < 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// return object name. the terminal unlinks it after reading
+static std::string write_shm(uint32_t image, const uint8_t *rgba, size_t size)
+{
+    auto name = "/termgrid-" + std::to_string(getpid()) + "-" +
+                std::to_string(image);
+    auto fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return {};
+    }
+    auto ok = ftruncate(fd, size) == 0;
+    if (ok)
+    {
+        auto p = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ok = false;
+        }
+        else
+        {
+            memcpy(p, rgba, size);
+            munmap(p, size);
+        }
+    }
+    close(fd);
+    if (!ok)
+    {
+        shm_unlink(name.c_str());
+        return {};
+    }
+    return name;
+}
+
+// kitty deletes only files containing "tty-graphics-protocol"
+static std::string write_temp(const uint8_t *rgba, size_t size)
+{
+    auto dir = getenv("TMPDIR");
+    std::string path = dir && dir[0] ? dir : "/tmp";
+    path += "/tty-graphics-protocol-XXXXXX";
+    auto fd = mkstemp(path.data());
+    if (fd < 0)
+    {
+        return {};
+    }
+    auto ok = write_all(fd, rgba, size);
+    close(fd);
+    if (!ok)
+    {
+        unlink(path.c_str());
+        return {};
+    }
+    return path;
+}
+
+KittyGraphics::KittyGraphics(KittyTransfers transfer) : m_transfer(transfer)
+{
+}
+
+void KittyGraphics::AppendQuery(std::string &out)
+{
+    // 1x1 rgb pixel. no q: the reply is what we want
+    append_command(out,
+                   "a=q,t=d,f=24,s=1,v=1,i=" + std::to_string(QUERY_IMAGE),
+                   "AAAA");
+    // DA1
+    out.append("\033[c");
+}
+
+KittySupport KittyGraphics::ParseQueryReply(std::string_view input)
+{
+    // reply: ESC _ G i=ID ; OK (or error message) ST
+    auto reply = "\033_Gi=" + std::to_string(QUERY_IMAGE) + ";";
+    auto kitty = input.find(reply);
+    // ESC [ ? ... c
+    auto da1 = input.find("\033[?");
+    while (da1 != std::string_view::npos)
+    {
+        auto end = input.find_first_not_of("0123456789;", da1 + 3);
+        if (end == std::string_view::npos)
+        {
+            // incomplete
+            da1 = std::string_view::npos;
+            break;
+        }
+        if (input[end] == 'c')
+        {
+            break;
+        }
+        da1 = input.find("\033[?", end);
+    }
+
+    if (kitty != std::string_view::npos &&
+        (da1 == std::string_view::npos || kitty < da1))
+    {
+        return input.substr(kitty + reply.size(), 2) == "OK"
+                   ? KittySupport::Yes
+                   : KittySupport::No;
+    }
+    if (da1 != std::string_view::npos)
+    {
+        return KittySupport::No;
+    }
+    return KittySupport::Unknown;
+}
+
+KittyTransfers KittyGraphics::DetectTransfer()
+{
+    if (getenv("SSH_CONNECTION") || getenv("SSH_TTY"))
+    {
+        // the terminal can not see our memory
+        return KittyTransfers::Direct;
+    }
+    return KittyTransfers::SharedMemory;
+}
+
+bool KittyGraphics::Transmit(std::string &out, uint32_t image,
+                             const uint8_t *rgba, int width, int height)
+{
+    size_t size = (size_t)width * height * 4;
+    // q=2: no response to read from the tty
+    auto keys = "a=t,f=32,q=2,s=" + std::to_string(width) +
+                ",v=" + std::to_string(height) + ",i=" + std::to_string(image);
+
+    // an object nobody consumes would be left behind
+    auto transfer =
+        m_support == KittySupport::Yes ? m_transfer : KittyTransfers::Direct;
+
+    std::string name;
+    switch (transfer)
+    {
+    case KittyTransfers::SharedMemory:
+        name = write_shm(image, rgba, size);
+        keys += ",t=s,S=" + std::to_string(size);
+        break;
+    case KittyTransfers::TempFile:
+        name = write_temp(rgba, size);
+        keys += ",t=t,S=" + std::to_string(size);
+        break;
+    case KittyTransfers::Direct:
+        break;
+    }
+
+    if (transfer != KittyTransfers::Direct)
+    {
+        if (name.empty())
+        {
+            return false;
+        }
+        std::string payload;
+        append_base64(payload, (const uint8_t *)name.data(), name.size());
+        append_command(out, keys, payload);
+        return true;
+    }
+
+    // m=1: more chunks follow
+    std::string payload;
+    for (size_t offset = 0; offset < size; offset += CHUNK_SIZE / 4 * 3)
+    {
+        auto n = std::min(size - offset, CHUNK_SIZE / 4 * 3);
+        payload.clear();
+        append_base64(payload, rgba + offset, n);
+        auto more = offset + n < size ? "m=1" : "m=0";
+        if (offset == 0)
+        {
+            append_command(out, keys + "," + more, payload);
+        }
+        else
+        {
+            append_command(out, more, payload);
+        }
+    }
+    return true;
+}
+
+uint32_t KittyGraphics::Upload(std::string &out, const uint8_t *rgba,
+                               int width, int height)
+{
+    if (width <= 0 || height <= 0 || m_support == KittySupport::No)
+    {
+        return 0;
+    }
+    auto image = m_nextImage++;
+    if (!Transmit(out, image, rgba, width, height))
+    {
+        return 0;
+    }
+    m_images.push_back(image);
+    return image;
+}
+
+void KittyGraphics::Put(std::string &out, TermcapEntry &entry,
+                        const Placement &p)
+{
+    entry.cursor_xy(out, p.x, p.y);
+    // same i and p replaces the placement. C=1: keep cursor
+    append_command(out, "a=p,q=2,C=1,i=" + std::to_string(p.image) +
+                            ",p=" + std::to_string(p.id) +
+                            ",c=" + std::to_string(p.cols) +
+                            ",r=" + std::to_string(p.rows));
+}
+
+uint32_t KittyGraphics::Place(std::string &out, TermcapEntry &entry,
+                              uint32_t image, int x, int y, int cols, int rows)
+{
+    if (std::find(m_images.begin(), m_images.end(), image) == m_images.end())
+    {
+        return 0;
+    }
+    m_placements.push_back({image, m_nextPlacement++, x, y, cols, rows});
+    Put(out, entry, m_placements.back());
+    return m_placements.back().id;
+}
+
+void KittyGraphics::Move(std::string &out, TermcapEntry &entry,
+                         uint32_t placement, int x, int y)
+{
+    for (auto &p : m_placements)
+    {
+        if (p.id == placement)
+        {
+            if (p.x != x || p.y != y)
+            {
+                p.x = x;
+                p.y = y;
+                Put(out, entry, p);
+            }
+            return;
+        }
+    }
+}
+
+void KittyGraphics::Scroll(std::string &out, TermcapEntry &entry, int dy,
+                           int top, int bottom)
+{
+    if (dy == 0)
+    {
+        return;
+    }
+    for (auto it = m_placements.begin(); it != m_placements.end();)
+    {
+        if (it->y < top || it->y > bottom)
+        {
+            ++it;
+            continue;
+        }
+        it->y -= dy;
+        if (it->y < top || it->y > bottom)
+        {
+            // scrolled out
+            append_delete(out, it->image, it->id);
+            it = m_placements.erase(it);
+            continue;
+        }
+        Put(out, entry, *it);
+        ++it;
+    }
+}
+
+void KittyGraphics::Remove(std::string &out, uint32_t placement)
+{
+    auto it = std::find_if(m_placements.begin(), m_placements.end(),
+                           [placement](auto &p) { return p.id == placement; });
+    if (it == m_placements.end())
+    {
+        return;
+    }
+    append_delete(out, it->image, it->id);
+    m_placements.erase(it);
+}
+
+void KittyGraphics::Release(std::string &out, uint32_t image)
+{
+    auto it = std::find(m_images.begin(), m_images.end(), image);
+    if (it == m_images.end())
+    {
+        return;
+    }
+    m_images.erase(it);
+    m_placements.erase(std::remove_if(m_placements.begin(), m_placements.end(),
+                                      [image](auto &p) { return p.image == image; }),
+                       m_placements.end());
+    // d=I: placements and image data
+    append_command(out, "a=d,d=I,q=2,i=" + std::to_string(image));
+}
+
+} // namespace termgrid
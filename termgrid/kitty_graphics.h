@@ -0,0 +1,114 @@
+#pragma once
+#include "termcap_entry.h"
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace termgrid
+{
+
+enum class KittyTransfers
+{
+    // base64 in the escape sequence. works over ssh
+    Direct,
+    // t=s: POSIX shared memory object
+    SharedMemory,
+    // t=t: temporary file. deleted by the terminal
+    TempFile,
+};
+
+enum class KittySupport
+{
+    // no reply yet
+    Unknown,
+    Yes,
+    No,
+};
+
+/// kitty graphics protocol の画像出力。
+///
+/// 画像は 1 度だけ upload して id で参照し、placement を何度でも置ける。
+/// local では pixel を shared memory か temp file で渡すので pty には
+/// 名前しか流れない。image id は端末全体で共有なので端末ごとに 1 つ作る。
+///
+/// command は q=2 で返事を読まないので、対応しない端末では shared memory や
+/// temp file が消されずに残る。AppendQuery の返事を ParseQueryReply で読み、
+/// SetSupport(Yes) するまでは Direct で送る。No なら Upload は失敗する。
+class KittyGraphics
+{
+    KittyTransfers m_transfer;
+    KittySupport m_support = KittySupport::Unknown;
+    uint32_t m_nextImage = 1;
+    uint32_t m_nextPlacement = 1;
+
+    struct Placement
+    {
+        uint32_t image;
+        uint32_t id;
+        int x;
+        int y;
+        int cols;
+        int rows;
+    };
+    std::vector<uint32_t> m_images;
+    std::vector<Placement> m_placements;
+
+public:
+    KittyGraphics(KittyTransfers transfer = DetectTransfer());
+
+    // Direct if ssh session
+    static KittyTransfers DetectTransfer();
+
+    KittyTransfers transfer() const
+    {
+        return m_transfer;
+    }
+
+    /// a=q の問い合わせと DA1。
+    /// kitty は a=q に答え、どの端末も DA1 に答えるので返事は必ず来る
+    static void AppendQuery(std::string &out);
+
+    /// tty から読んだ byte 列。DA1 の返事より前に a=q の返事があれば Yes
+    static KittySupport ParseQueryReply(std::string_view input);
+
+    KittySupport support() const
+    {
+        return m_support;
+    }
+    void SetSupport(KittySupport support)
+    {
+        m_support = support;
+    }
+
+    /// rgba: width * height * 4 bytes.
+    /// return image id. 0 if fail
+    uint32_t Upload(std::string &out, const uint8_t *rgba, int width,
+                    int height);
+
+    /// put image to cell (x, y) scaled to cols x rows cells.
+    /// return placement id. 0 if no image
+    uint32_t Place(std::string &out, TermcapEntry &entry, uint32_t image, int x,
+                   int y, int cols, int rows);
+
+    // replace the placement. pixels are not sent again
+    void Move(std::string &out, TermcapEntry &entry, uint32_t placement, int x,
+              int y);
+
+    /// rows [top, bottom] was redrawn dy rows up (dy < 0: down).
+    /// move placements in the region by reference, delete scrolled out
+    void Scroll(std::string &out, TermcapEntry &entry, int dy, int top,
+                int bottom);
+
+    void Remove(std::string &out, uint32_t placement);
+
+    // delete image and its placements. frees terminal memory
+    void Release(std::string &out, uint32_t image);
+
+private:
+    bool Transmit(std::string &out, uint32_t image, const uint8_t *rgba,
+                  int width, int height);
+    void Put(std::string &out, TermcapEntry &entry, const Placement &p);
+};
+
+} // namespace termgrid
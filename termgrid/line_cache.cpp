@@ -0,0 +1,51 @@
+#include "line_cache.h"
+
+namespace termgrid
+{
+
+void EncodedLineCache::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+}
+
+const std::string *EncodedLineCache::Find(uint64_t version, int x, int width)
+{
+    auto found = m_index.find({version, x, width});
+    if (found == m_index.end())
+    {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    // to the newest
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    return &found->second->bytes;
+}
+
+void EncodedLineCache::Store(uint64_t version, int x, int width,
+                             std::string_view bytes)
+{
+    Key key{version, x, width};
+    if (!m_capacity)
+    {
+        return;
+    }
+    if (m_index.size() >= m_capacity)
+    {
+        // reuse the oldest entry and its buffer
+        auto oldest = std::prev(m_entries.end());
+        m_index.erase(oldest->key);
+        m_entries.splice(m_entries.begin(), m_entries, oldest);
+    }
+    else
+    {
+        m_entries.emplace_front();
+    }
+    auto &entry = m_entries.front();
+    entry.key = key;
+    entry.bytes.assign(bytes);
+    m_index.emplace(key, m_entries.begin());
+}
+
+} // namespace termgrid
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace termgrid
+{
+
+/// 行の encode 結果を (TermLine::version, x, width) で持つ cache。
+///
+/// scroll や pane の移動で内容の変わらない行を別の位置に出し直すとき、
+/// cell を encode し直さずに byte 列を copy する。
+/// 古いものから capacity を超えた分を捨てる。
+/// encode の仕方 (backend, padding) は cache ごとに 1 つにする。
+class EncodedLineCache
+{
+    struct Key
+    {
+        uint64_t version;
+        int x;
+        int width;
+
+        bool operator==(const Key &) const = default;
+    };
+
+    struct Hash
+    {
+        size_t operator()(const Key &key) const
+        {
+            return std::hash<uint64_t>()(key.version ^
+                                         ((uint64_t)key.x << 40) ^
+                                         ((uint64_t)key.width << 20));
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::string bytes;
+    };
+
+    size_t m_capacity;
+    // front is the newest
+    std::list<Entry> m_entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, Hash> m_index;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+
+public:
+    /// capacity は行数。画面数枚分あればよい
+    EncodedLineCache(size_t capacity = 1024) : m_capacity(capacity)
+    {
+    }
+
+    /// version の行の column [x, x + width) を out に追記する。
+    /// cache になければ encode(out) で追記して覚える。version 0 は cache しない
+    template <typename F>
+    void Emit(std::string &out, uint64_t version, int x, int width,
+              const F &encode)
+    {
+        if (!version)
+        {
+            encode(out);
+            return;
+        }
+        if (auto bytes = Find(version, x, width))
+        {
+            out.append(*bytes);
+            return;
+        }
+        auto begin = out.size();
+        encode(out);
+        Store(version, x, width, std::string_view(out).substr(begin));
+    }
+
+    /// なければ nullptr。次の Store までしか使えない
+    const std::string *Find(uint64_t version, int x, int width);
+    void Store(uint64_t version, int x, int width, std::string_view bytes);
+
+    uint64_t hits() const
+    {
+        return m_hits;
+    }
+    uint64_t misses() const
+    {
+        return m_misses;
+    }
+
+    void clear();
+};
+
+} // namespace termgrid
@@ -0,0 +1,235 @@
+#include "log_pane.h"
+#include "encoder.h"
+#include <algorithm>
+
+namespace termgrid
+{
+
+static const int TAB_COLS = 8;
+// m_styleLimit at least
+static const size_t MIN_STYLE_LIMIT = 4096;
+
+// C0, DEL and C1. written raw they are commands to the terminal
+static bool is_control(char32_t c)
+{
+    return c < 0x20 || (c >= 0x7F && c < 0xA0);
+}
+
+// 0 if invalid or truncated
+static int utf8_length(const uint8_t *p, size_t remain)
+{
+    int len;
+    if (p[0] < 0x80)
+    {
+        return 1;
+    }
+    else if ((p[0] & 0xE0) == 0xC0)
+    {
+        len = 2;
+    }
+    else if ((p[0] & 0xF0) == 0xE0)
+    {
+        len = 3;
+    }
+    else if ((p[0] & 0xF8) == 0xF0)
+    {
+        len = 4;
+    }
+    else
+    {
+        return 0;
+    }
+    if (remain < (size_t)len)
+    {
+        return 0;
+    }
+    for (int i = 1; i < len; ++i)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+    return len;
+}
+
+LogPane::LogPane(int top, int height, size_t capacity,
+                 const TermLine::GetColsFunc &getCols)
+    : m_top(top), m_height(height), m_getCols(getCols),
+      m_styleLimit(MIN_STYLE_LIMIT), m_ring(capacity)
+{
+}
+
+const StyledLine &LogPane::Line(size_t index) const
+{
+    auto first = m_appended - size();
+    return m_ring[(first + index) % m_ring.size()];
+}
+
+StyledLine &LogPane::NextLine()
+{
+    auto &l = m_ring[m_appended % m_ring.size()];
+    ++m_appended;
+    // keep capacity
+    l.clear();
+    if (m_scroll)
+    {
+        // keep the viewed lines in place
+        m_scroll = std::min<size_t>(m_scroll + 1, size());
+    }
+    return l;
+}
+
+void LogPane::Append(std::string_view utf8)
+{
+    auto &l = NextLine();
+    auto p = (const uint8_t *)utf8.data();
+    auto end = p + utf8.size();
+    int x = 0;
+    while (p < end)
+    {
+        auto len = utf8_length(p, end - p);
+        if (!len)
+        {
+            // one byte of a broken sequence
+            l.push({c8::utf8::codepoint(u8"�"), 1}, 0);
+            x += 1;
+            ++p;
+            continue;
+        }
+        auto cp = c8::utf8::codepoint((const char8_t *)p);
+        p += len;
+        auto unicode = cp.to_unicode();
+        if (unicode == '\t')
+        {
+            auto space = c8::utf8::codepoint(u8" ");
+            for (auto n = TAB_COLS - x % TAB_COLS; n > 0; --n, ++x)
+            {
+                l.push({space, 1}, 0);
+            }
+            continue;
+        }
+        if (is_control(unicode))
+        {
+            // \r, ESC and other controls
+            continue;
+        }
+        int cols = cp.codeunit_count() == 1
+                       ? 1
+                       : std::max(0, m_getCols(unicode));
+        l.push({cp, cols}, 0);
+        x += cols;
+    }
+}
+
+void LogPane::AppendLine(tcb::span<const TermCodepoint> codes)
+{
+    auto &l = NextLine();
+    if (std::none_of(codes.begin(), codes.end(), [](const TermCodepoint &c) {
+            return is_control(c.cp.to_unicode());
+        }))
+    {
+        l.Assign(codes, m_styles);
+    }
+    else
+    {
+        // drop controls
+        for (auto &c : codes)
+        {
+            if (!is_control(c.cp.to_unicode()))
+            {
+                l.push({c.cp, c.cols}, m_styles.Intern(GetStyle(c)));
+            }
+        }
+    }
+
+    if (m_styles.size() > m_styleLimit)
+    {
+        CompactStyles();
+    }
+}
+
+void LogPane::CompactStyles()
+{
+    TermStyleTable styles;
+    for (auto &line : m_ring)
+    {
+        for (auto &run : line.runs)
+        {
+            run.style = styles.Intern(m_styles.Get(run.style));
+        }
+    }
+    m_styles = std::move(styles);
+    // amortized over the lines appended until the next compaction
+    m_styleLimit = std::max(MIN_STYLE_LIMIT, m_styles.size() * 2);
+}
+
+void LogPane::SetScroll(size_t lines)
+{
+    lines = std::min(lines, size());
+    if (lines != m_scroll)
+    {
+        m_scroll = lines;
+        m_redraw = true;
+    }
+}
+
+void LogPane::Resize(int top, int height)
+{
+    m_top = top;
+    m_height = height;
+    m_redraw = true;
+}
+
+// line: index from tail. 0 is the last line
+void LogPane::DrawRow(std::string &out, const TermcapEntryPtr &entry, int row,
+                      uint64_t line)
+{
+    entry->cursor_xy(out, 0, m_top + row);
+    if (line < size())
+    {
+        EncodeStyledLine(out, Line(size() - 1 - line), m_styles,
+                         entry->columns());
+    }
+    entry->clear_to_eol(out);
+}
+
+void LogPane::Flush(std::string &out, const TermcapEntryPtr &entry)
+{
+    auto pending = m_appended - m_flushed;
+    m_flushed = m_appended;
+
+    if (m_scroll && !m_redraw)
+    {
+        // view is fixed
+        return;
+    }
+
+    if (m_redraw || pending >= (uint64_t)m_height)
+    {
+        // skip lines scrolled out before shown
+        for (int row = 0; row < m_height; ++row)
+        {
+            DrawRow(out, entry, row, m_scroll + m_height - 1 - row);
+        }
+        m_redraw = false;
+        return;
+    }
+
+    if (pending == 0)
+    {
+        return;
+    }
+
+    auto bottom = m_top + m_height - 1;
+    entry->scroll_region(out, m_top, bottom);
+    entry->cursor_xy(out, 0, bottom);
+    entry->scroll_forward(out, pending);
+    for (int row = m_height - pending; row < m_height; ++row)
+    {
+        DrawRow(out, entry, row, m_height - 1 - row);
+    }
+    entry->scroll_region(out, 0, entry->lines() - 1);
+}
+
+} // namespace termgrid
@@ -0,0 +1,85 @@
+#pragma once
+#include "style.h"
+#include "termcap_entry.h"
+#include "termgrid.h"
+#include <string>
+#include <vector>
+
+namespace termgrid
+{
+
+/// 追記専用の log 表示。
+///
+/// 行は固定長の ring buffer に入り、古い行から上書きされる。
+/// Flush は scroll region を使って前回から増えた行だけを書く。
+/// 1 画面以上たまっていたら途中の行は書かずに最後の 1 画面だけ書く
+/// (ring buffer には残る)。
+/// scroll region は行単位なので pane は画面の幅いっぱいを使う。
+/// 行の属性は run で持ち、style は pane の table に intern する。
+/// table は ring に残っている style だけに作り直すので際限なく増えない。
+class LogPane
+{
+    int m_top;
+    int m_height;
+    TermLine::GetColsFunc m_getCols;
+
+    TermStyleTable m_styles;
+    // compact m_styles when it grows over this
+    size_t m_styleLimit;
+    std::vector<StyledLine> m_ring;
+    // total appended. next slot is m_appended % capacity
+    uint64_t m_appended = 0;
+    // m_appended at last Flush
+    uint64_t m_flushed = 0;
+
+    // lines from tail. 0 follows new lines
+    size_t m_scroll = 0;
+    bool m_redraw = true;
+
+public:
+    LogPane(int top, int height, size_t capacity,
+            const TermLine::GetColsFunc &getCols);
+
+    size_t capacity() const
+    {
+        return m_ring.size();
+    }
+
+    // lines in buffer
+    size_t size() const
+    {
+        return std::min<uint64_t>(m_appended, m_ring.size());
+    }
+
+    // style ids of lines are valid until the next AppendLine
+    const TermStyleTable &styles() const
+    {
+        return m_styles;
+    }
+
+    // 0 is the oldest in buffer
+    const StyledLine &Line(size_t index) const;
+
+    // utf-8 without '\n'. default style. tab is expanded, other controls are
+    // dropped
+    void Append(std::string_view utf8);
+
+    // styled cells. controls are dropped
+    void AppendLine(tcb::span<const TermCodepoint> codes);
+
+    void SetScroll(size_t lines);
+
+    void Resize(int top, int height);
+
+    void Flush(std::string &out, const TermcapEntryPtr &entry);
+
+private:
+    // re-intern the styles of lines in the ring only
+    void CompactStyles();
+    // clear the next slot and return it
+    StyledLine &NextLine();
+    void DrawRow(std::string &out, const TermcapEntryPtr &entry, int row,
+                 uint64_t line);
+};
+
+} // namespace termgrid
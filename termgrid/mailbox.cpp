@@ -0,0 +1,36 @@
+#include "mailbox.h"
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace termgrid
+{
+
+Wakeup::Wakeup() : m_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+}
+
+Wakeup::~Wakeup()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+void Wakeup::Notify()
+{
+    uint64_t one = 1;
+    // fails only if the counter overflows. it is readable anyway
+    auto n = write(m_fd, &one, sizeof(one));
+    (void)n;
+}
+
+void Wakeup::Clear()
+{
+    uint64_t value;
+    auto n = read(m_fd, &value, sizeof(value));
+    (void)n;
+}
+
+} // namespace termgrid
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+namespace termgrid
+{
+
+/// 最新の値を 1 つだけ渡す lock-free な slot。
+///
+/// producer (何 thread でも) は Publish で値を置き、まだ読まれていない古い値は捨てる。
+/// consumer (tty thread) は Take で最新の値だけを受け取る。
+/// 値は heap の node に入れて pointer を atomic に交換する。
+template <typename T> class LatestMailbox
+{
+    std::atomic<T *> m_slot{nullptr};
+
+public:
+    LatestMailbox() = default;
+    ~LatestMailbox()
+    {
+        delete m_slot.exchange(nullptr);
+    }
+    LatestMailbox(const LatestMailbox &) = delete;
+    LatestMailbox &operator=(const LatestMailbox &) = delete;
+
+    /// return true if the slot was empty. wake the consumer only then
+    bool Publish(T value)
+    {
+        auto old = m_slot.exchange(new T(std::move(value)),
+                                   std::memory_order_acq_rel);
+        if (old)
+        {
+            // dropped on the producer thread
+            delete old;
+            return false;
+        }
+        return true;
+    }
+
+    /// false if nothing new since the last Take
+    bool Take(T &out)
+    {
+        auto p = m_slot.exchange(nullptr, std::memory_order_acq_rel);
+        if (!p)
+        {
+            return false;
+        }
+        out = std::move(*p);
+        delete p;
+        return true;
+    }
+};
+
+/// Publish が true を返したときに consumer を起こす eventfd。
+/// fd() を asio や poll で待つ。
+class Wakeup
+{
+    int m_fd = -1;
+
+public:
+    Wakeup();
+    ~Wakeup();
+    Wakeup(const Wakeup &) = delete;
+    Wakeup &operator=(const Wakeup &) = delete;
+
+    int fd() const
+    {
+        return m_fd;
+    }
+
+    void Notify();
+
+    // consumer. before Take
+    void Clear();
+};
+
+} // namespace termgrid
@@ -0,0 +1,195 @@
+#include "pty_pane.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace termgrid
+{
+
+static const size_t READ_SIZE = 64 * 1024;
+// return to the event loop after this. a child writing forever (yes) must
+// not starve input and redraw
+static const size_t MAX_READ_PER_CALL = 4 * READ_SIZE;
+
+static winsize to_winsize(const TermSize &size)
+{
+    winsize ws = {};
+    ws.ws_col = size.width;
+    ws.ws_row = size.height;
+    return ws;
+}
+
+PtyPane::PtyPane(const TermSize &size, const TermLine::GetColsFunc &getCols)
+    : m_screen(size), m_parser(m_screen, getCols), m_buffer(READ_SIZE)
+{
+}
+
+PtyPane::~PtyPane()
+{
+    Close();
+}
+
+bool PtyPane::Spawn(const std::vector<std::string> &argv)
+{
+    if (argv.empty() || m_master >= 0)
+    {
+        return false;
+    }
+
+    auto ws = to_winsize(m_screen.size());
+    int master;
+    auto pid = forkpty(&master, nullptr, nullptr, &ws);
+    if (pid < 0)
+    {
+        return false;
+    }
+    if (pid == 0)
+    {
+        // child
+        setenv("TERM", "xterm-256color", 1);
+        std::vector<char *> args;
+        for (auto &arg : argv)
+        {
+            args.push_back((char *)arg.c_str());
+        }
+        args.push_back(nullptr);
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    m_master = master;
+    m_pid = pid;
+    return true;
+}
+
+bool PtyPane::Read()
+{
+    m_moreOutput = false;
+    if (m_master < 0)
+    {
+        return false;
+    }
+    size_t total = 0;
+    while (true)
+    {
+        if (total >= MAX_READ_PER_CALL)
+        {
+            m_moreOutput = true;
+            break;
+        }
+        auto n = read(m_master, m_buffer.data(), m_buffer.size());
+        if (n > 0)
+        {
+            m_received += n;
+            total += n;
+            m_parser.Feed({m_buffer.data(), (size_t)n});
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        // EOF or EIO: the child closed the slave
+        return false;
+    }
+
+    m_parser.TakeReply(m_reply);
+    if (m_reply.size())
+    {
+        // DSR/DA replies keep their order with the queued input
+        Write(m_reply);
+        m_reply.clear();
+    }
+    else
+    {
+        FlushInput();
+    }
+    return true;
+}
+
+size_t PtyPane::TryWrite(std::string_view input)
+{
+    size_t written = 0;
+    while (m_master >= 0 && written < input.size())
+    {
+        auto n = write(m_master, input.data() + written, input.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        written += n;
+    }
+    return written;
+}
+
+void PtyPane::Write(std::string_view input)
+{
+    m_input.append(input);
+    FlushInput();
+}
+
+bool PtyPane::FlushInput()
+{
+    if (m_input.size())
+    {
+        m_input.erase(0, TryWrite(m_input));
+    }
+    return m_input.empty();
+}
+
+void PtyPane::Resize(const TermSize &size)
+{
+    m_screen.Resize(size);
+    m_parser.Resize();
+    if (m_master >= 0)
+    {
+        auto ws = to_winsize(size);
+        ioctl(m_master, TIOCSWINSZ, &ws);
+    }
+}
+
+void PtyPane::Sync(TermPane &pane)
+{
+    auto height = std::min(m_screen.size().height, pane.rect().height);
+    for (int y = 0; y < height; ++y)
+    {
+        if (m_screen.IsDirty(y))
+        {
+            m_screen.GetLine(y, pane.Edit(y));
+        }
+    }
+    m_screen.ClearDirty();
+}
+
+int PtyPane::Close()
+{
+    if (m_master >= 0)
+    {
+        close(m_master);
+        m_master = -1;
+    }
+    if (m_pid > 0)
+    {
+        kill(m_pid, SIGHUP);
+        while (waitpid(m_pid, &m_status, 0) < 0 && errno == EINTR)
+        {
+        }
+        m_pid = -1;
+    }
+    return m_status;
+}
+
+} // namespace termgrid
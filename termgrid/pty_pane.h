@@ -0,0 +1,110 @@
+#pragma once
+#include "compositor.h"
+#include "screen.h"
+#include "vt_parser.h"
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+namespace termgrid
+{
+
+/// 子 process を pty で動かし、出力を TermScreen に描く pane。
+///
+/// fd() が読めるようになったら Read を呼ぶ。Read は読めるだけ (1 回に上限まで)
+/// 読んで parse し、変わった行は screen の dirty になる。
+/// 子への入力は queue に積んで書けるだけ書く。残りは fd() が書けるように
+/// なったら FlushInput で書く。入力が詰まっても出力は読み続けられる。
+class PtyPane
+{
+    TermScreen m_screen;
+    VtParser m_parser;
+    int m_master = -1;
+    pid_t m_pid = -1;
+    int m_status = 0;
+    std::vector<char> m_buffer;
+    std::string m_reply;
+    // input and replies not written yet
+    std::string m_input;
+    // Read stopped at the limit. more output may be there
+    bool m_moreOutput = false;
+    // total output bytes from the child
+    uint64_t m_received = 0;
+
+public:
+    PtyPane(const TermSize &size, const TermLine::GetColsFunc &getCols);
+    ~PtyPane();
+    PtyPane(const PtyPane &) = delete;
+    PtyPane &operator=(const PtyPane &) = delete;
+
+    // execvp(argv[0], argv) on a new pty. TERM=xterm-256color
+    bool Spawn(const std::vector<std::string> &argv);
+
+    // pty master. -1 if not running
+    int fd() const
+    {
+        return m_master;
+    }
+
+    const TermScreen &screen() const
+    {
+        return m_screen;
+    }
+    TermScreen &screen()
+    {
+        return m_screen;
+    }
+
+    const VtParser &parser() const
+    {
+        return m_parser;
+    }
+
+    /// non-blocking. false if the child closed the pty.
+    /// stops after a limit. then HasMoreOutput() and call again from the loop
+    bool Read();
+
+    bool HasMoreOutput() const
+    {
+        return m_moreOutput;
+    }
+
+    uint64_t received() const
+    {
+        return m_received;
+    }
+
+    // keyboard input to the child. non-blocking. the rest is queued
+    void Write(std::string_view input);
+
+    // write queued input. true if nothing is left
+    bool FlushInput();
+
+    // wait fd() writable and FlushInput
+    bool HasPendingInput() const
+    {
+        return !m_input.empty();
+    }
+
+    // lines scrolled off the top of the screen go here. not owned
+    void SetHistory(Scrollback *history)
+    {
+        m_parser.SetHistory(history);
+    }
+
+    // screen and pty window size. the child gets SIGWINCH
+    void Resize(const TermSize &size);
+
+    /// screen の dirty 行を compositor の pane に写して dirty を消す
+    void Sync(TermPane &pane);
+
+    // close pty and wait the child. return exit status
+    int Close();
+
+private:
+    // return written bytes. less than input if the pty input buffer is full
+    size_t TryWrite(std::string_view input);
+};
+
+} // namespace termgrid
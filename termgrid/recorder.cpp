@@ -0,0 +1,305 @@
+#include "recorder.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+
+namespace termgrid
+{
+
+static const char MAGIC[] = "TGREC";
+static const uint8_t VERSION = 1;
+
+static void push_cell(std::vector<uint8_t> &out, const TermCodepoint &c)
+{
+    auto size = c.cp.codeunit_count();
+    out.push_back((uint8_t)size);
+    out.insert(out.end(), c.cp.data(), c.cp.data() + size);
+    out.push_back((uint8_t)c.cols);
+    push_varint(out, c.flags);
+    push_color(out, c.fgcolor);
+    push_color(out, c.bgcolor);
+}
+
+// false if the record is broken or truncated
+static bool read_cell(const uint8_t *&p, const uint8_t *end, TermCodepoint &c)
+{
+    if (p >= end)
+    {
+        return false;
+    }
+    auto size = *p++;
+    // utf-8 and cols
+    if (size < 1 || size > 4 || end - p < size + 1)
+    {
+        return false;
+    }
+    char8_t utf8[5] = {};
+    memcpy(utf8, p, size);
+    p += size;
+    c.cp = c8::utf8::codepoint(utf8);
+    c.cols = *p++;
+    uint64_t flags;
+    if (!read_varint(p, end, flags))
+    {
+        return false;
+    }
+    c.flags = (int)flags;
+    return read_color(p, end, c.fgcolor) && read_color(p, end, c.bgcolor);
+}
+
+//
+// Recorder
+//
+Recorder::Recorder(const char *path, int keyframeInterval)
+    : m_os(path, std::ios::binary),
+      m_keyframeInterval(std::max(1, keyframeInterval)),
+      m_last(std::chrono::steady_clock::now())
+{
+    if (m_os)
+    {
+        m_os.write(MAGIC, sizeof(MAGIC));
+        m_os.put(VERSION);
+    }
+}
+
+void Recorder::BeginRecord(RecordTypes type)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto us =
+        std::chrono::duration_cast<std::chrono::microseconds>(now - m_last)
+            .count();
+    m_last = now;
+    m_buffer.clear();
+    m_buffer.push_back((uint8_t)type);
+    push_varint(m_buffer, us);
+}
+
+void Recorder::Flush()
+{
+    m_os.write((const char *)m_buffer.data(), m_buffer.size());
+}
+
+void Recorder::Frame(const TermScreen &screen, size_t bytes)
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+
+    auto &size = screen.size();
+    auto &prev = m_prev.size();
+    if (m_frames++ % m_keyframeInterval == 0 || size.width != prev.width ||
+        size.height != prev.height)
+    {
+        BeginRecord(RecordTypes::Keyframe);
+        push_varint(m_buffer, size.width);
+        push_varint(m_buffer, size.height);
+        push_varint(m_buffer, bytes);
+        for (int y = 0; y < size.height; ++y)
+        {
+            for (auto &c : screen.Row(y))
+            {
+                push_cell(m_buffer, c);
+            }
+        }
+        m_prev = screen;
+        Flush();
+        return;
+    }
+
+    BeginRecord(RecordTypes::Delta);
+    push_varint(m_buffer, bytes);
+    // runs of changed cells in row major order
+    std::vector<std::pair<int, int>> runs;
+    int count = size.width * size.height;
+    for (int i = 0; i < count;)
+    {
+        auto x = i % size.width;
+        auto y = i / size.width;
+        if (IsSameCell(screen.Cell(x, y), m_prev.Cell(x, y)))
+        {
+            ++i;
+            continue;
+        }
+        auto begin = i;
+        for (++i; i < count; ++i)
+        {
+            x = i % size.width;
+            y = i / size.width;
+            if (IsSameCell(screen.Cell(x, y), m_prev.Cell(x, y)))
+            {
+                break;
+            }
+        }
+        runs.push_back({begin, i - begin});
+    }
+
+    push_varint(m_buffer, runs.size());
+    int end = 0;
+    for (auto [begin, length] : runs)
+    {
+        push_varint(m_buffer, begin - end);
+        push_varint(m_buffer, length);
+        for (int i = begin; i < begin + length; ++i)
+        {
+            auto x = i % size.width;
+            auto y = i / size.width;
+            push_cell(m_buffer, screen.Cell(x, y));
+            m_prev.Set(x, y, screen.Cell(x, y));
+        }
+        end = begin + length;
+    }
+    Flush();
+}
+
+void Recorder::Input(std::string_view data)
+{
+    if (!IsOpen())
+    {
+        return;
+    }
+    BeginRecord(RecordTypes::Input);
+    push_varint(m_buffer, data.size());
+    m_buffer.insert(m_buffer.end(), data.begin(), data.end());
+    Flush();
+}
+
+//
+// Player
+//
+std::shared_ptr<Player> Player::open(const char *path)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+    {
+        return nullptr;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(is)),
+                              std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(MAGIC) + 1 ||
+        memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+        data[sizeof(MAGIC)] != VERSION)
+    {
+        return nullptr;
+    }
+    return std::make_shared<Player>(std::move(data));
+}
+
+Player::Player(std::vector<uint8_t> &&data)
+    : m_data(std::move(data)), m_pos(sizeof(MAGIC) + 1)
+{
+    m_end = m_data.size();
+}
+
+bool Player::Next(Event &event)
+{
+    if (m_pos >= m_end)
+    {
+        return false;
+    }
+
+    const uint8_t *p = m_data.data() + m_pos;
+    const uint8_t *end = m_data.data() + m_end;
+    event.type = (RecordTypes)*p++;
+    uint64_t us;
+    if (!read_varint(p, end, us))
+    {
+        return false;
+    }
+    m_time += us;
+    event.time = m_time;
+    event.bytes = 0;
+    event.input = {};
+
+    switch (event.type)
+    {
+    case RecordTypes::Keyframe:
+    {
+        uint64_t width, height, bytes;
+        if (!read_varint(p, end, width) || !read_varint(p, end, height) ||
+            !read_varint(p, end, bytes))
+        {
+            return false;
+        }
+        event.bytes = bytes;
+        // a cell takes 4 bytes at least
+        if (width > INT_MAX || height > INT_MAX ||
+            width * height > (size_t)(end - p) / 4)
+        {
+            return false;
+        }
+        if ((int)width != m_screen.size().width ||
+            (int)height != m_screen.size().height)
+        {
+            m_screen.Resize({(int)width, (int)height});
+        }
+        TermCodepoint c{};
+        for (int y = 0; y < (int)height; ++y)
+        {
+            for (int x = 0; x < (int)width; ++x)
+            {
+                if (!read_cell(p, end, c))
+                {
+                    return false;
+                }
+                m_screen.Set(x, y, c);
+            }
+        }
+        break;
+    }
+
+    case RecordTypes::Delta:
+    {
+        uint64_t bytes, runs;
+        if (!read_varint(p, end, bytes) || !read_varint(p, end, runs))
+        {
+            return false;
+        }
+        event.bytes = bytes;
+        auto &size = m_screen.size();
+        size_t count = size.width * size.height;
+        size_t i = 0;
+        TermCodepoint c{};
+        for (uint64_t r = 0; r < runs; ++r)
+        {
+            uint64_t skip, length;
+            if (!read_varint(p, end, skip) || !read_varint(p, end, length) ||
+                skip > count - i || length > count - i - skip)
+            {
+                return false;
+            }
+            i += skip;
+            for (auto last = i + length; i < last; ++i)
+            {
+                if (!read_cell(p, end, c))
+                {
+                    return false;
+                }
+                m_screen.Set(i % size.width, i / size.width, c);
+            }
+        }
+        break;
+    }
+
+    case RecordTypes::Input:
+    {
+        uint64_t size;
+        if (!read_varint(p, end, size) || size > (size_t)(end - p))
+        {
+            return false;
+        }
+        event.input = std::string_view((const char *)p, size);
+        p += size;
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    m_pos = p - m_data.data();
+    return true;
+}
+
+} // namespace termgrid
@@ -0,0 +1,92 @@
+#pragma once
+#include "screen.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string_view>
+
+namespace termgrid
+{
+
+/// frame の記録形式
+///
+/// header: "TGREC" 0x00 version
+/// record: type(u8) time(varint. micro seconds from previous record) payload
+///   Keyframe: width height bytes cells(width x height)
+///   Delta: bytes runs [skip length cells(length)]...
+///   Input: size data
+/// cell: utf8 size(u8) utf8 cols(u8) flags fgcolor bgcolor
+///
+/// bytes は frame を出力したときの端末への byte 数
+enum class RecordTypes : uint8_t
+{
+    Keyframe = 1,
+    Delta = 2,
+    Input = 3,
+};
+
+/// TermScreen の frame と入力を時刻付きで記録する。
+/// frame は前の frame との cell の差分で、keyframeInterval 毎に全 cell を持つ。
+class Recorder
+{
+    std::ofstream m_os;
+    int m_keyframeInterval;
+    int m_frames = 0;
+    TermScreen m_prev;
+    std::chrono::steady_clock::time_point m_last;
+    std::vector<uint8_t> m_buffer;
+
+public:
+    // keyframeInterval < 1 is 1 (every frame is a keyframe)
+    Recorder(const char *path, int keyframeInterval = 120);
+
+    bool IsOpen() const
+    {
+        return m_os.is_open();
+    }
+
+    void Frame(const TermScreen &screen, size_t bytes);
+    void Input(std::string_view data);
+
+private:
+    void BeginRecord(RecordTypes type);
+    void Flush();
+};
+using RecorderPtr = std::shared_ptr<Recorder>;
+
+/// Recorder の記録を先頭から読んで screen に適用する
+class Player
+{
+    std::vector<uint8_t> m_data;
+    size_t m_pos = 0;
+    size_t m_end = 0;
+    uint64_t m_time = 0;
+    TermScreen m_screen;
+
+public:
+    struct Event
+    {
+        RecordTypes type;
+        // micro seconds from start
+        uint64_t time;
+        // Keyframe, Delta
+        size_t bytes;
+        // Input
+        std::string_view input;
+    };
+
+    static std::shared_ptr<Player> open(const char *path);
+
+    Player(std::vector<uint8_t> &&data);
+
+    // false at end or broken record
+    bool Next(Event &event);
+
+    TermScreen &screen()
+    {
+        return m_screen;
+    }
+};
+using PlayerPtr = std::shared_ptr<Player>;
+
+} // namespace termgrid
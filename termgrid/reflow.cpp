@@ -0,0 +1,260 @@
+#include "reflow.h"
+#include <algorithm>
+
+namespace termgrid
+{
+
+static bool is_space(const TermCodepoint &c)
+{
+    return c.cp.codeunit_count() == 1 && *c.cp.data() == ' ';
+}
+
+void LineWrap::Build(const TermLine &line, bool wordWrap)
+{
+    auto &codes = line.codes;
+    m_colsAt.clear();
+    m_breaks.clear();
+    m_colsAt.reserve(codes.size() + 1);
+    uint32_t x = 0;
+    for (auto &c : codes)
+    {
+        m_colsAt.push_back(x);
+        x += std::max(0, c.cols);
+    }
+    m_colsAt.push_back(x);
+
+    if (!wordWrap)
+    {
+        return;
+    }
+    for (size_t i = 1; i < codes.size(); ++i)
+    {
+        auto &prev = codes[i - 1];
+        if (prev.cols <= 0)
+        {
+            // inside a cluster
+            continue;
+        }
+        if (is_space(prev))
+        {
+            // the space may hang over the right edge
+            m_breaks.push_back({(uint32_t)i, m_colsAt[i - 1]});
+        }
+        else if (prev.cols >= 2 || codes[i].cols >= 2)
+        {
+            // around wide chars
+            m_breaks.push_back({(uint32_t)i, m_colsAt[i]});
+        }
+    }
+}
+
+WrapRow LineWrap::NextRow(const WrapRow &row, uint32_t limit) const
+{
+    // the last word break that fits
+    auto it = std::upper_bound(
+        m_breaks.begin(), m_breaks.end(), limit,
+        [](uint32_t limit, const Break &b) { return limit < b.col; });
+    if (it != m_breaks.begin() && (it - 1)->index > row.begin)
+    {
+        auto i = (it - 1)->index;
+        return {i, m_colsAt[i]};
+    }
+
+    // break inside the word. the last cluster boundary that fits
+    auto begin = m_colsAt.begin();
+    auto i = std::upper_bound(begin, m_colsAt.end(), limit) - begin - 1;
+    // zero width codepoints belong to the next cluster
+    i = std::lower_bound(begin, m_colsAt.end(), m_colsAt[i]) - begin;
+    if (i <= (int64_t)row.begin)
+    {
+        // a cluster wider than the width. put it alone
+        i = std::upper_bound(begin, m_colsAt.end(), row.col) - begin;
+    }
+    return {(uint32_t)i, m_colsAt[i]};
+}
+
+void LineWrap::Wrap(int width, std::vector<WrapRow> &rows) const
+{
+    rows.clear();
+    rows.push_back({0, 0});
+    if (width <= 0)
+    {
+        return;
+    }
+    auto total = cols();
+    while (total - rows.back().col > (uint32_t)width)
+    {
+        auto next = NextRow(rows.back(), rows.back().col + width);
+        if (next.col >= total)
+        {
+            // the last cluster is wider than the width
+            break;
+        }
+        rows.push_back(next);
+    }
+}
+
+ReflowIndex::ReflowIndex(const GetLineFunc &getLine, bool wordWrap)
+    : m_getLine(getLine), m_wordWrap(wordWrap)
+{
+}
+
+void ReflowIndex::Sync(size_t lines)
+{
+    if (lines < size())
+    {
+        // source was cleared
+        m_cols.clear();
+        m_rows.clear();
+        m_wraps.clear();
+        m_knownRows = 0;
+        m_unknownLines = 0;
+        m_next = 0;
+    }
+    m_unknownLines += lines - size();
+    m_cols.resize(lines, UNKNOWN);
+    m_wraps.resize(lines);
+    m_rows.resize(lines, 0);
+}
+
+void ReflowIndex::Resize(int width)
+{
+    if (width == m_width)
+    {
+        return;
+    }
+    m_width = width;
+    std::fill(m_rows.begin(), m_rows.end(), 0);
+    m_knownRows = 0;
+    m_unknownLines = size();
+    m_next = size();
+}
+
+uint32_t ReflowIndex::Cols(size_t line)
+{
+    auto &cols = m_cols[line];
+    if (cols == UNKNOWN)
+    {
+        cols = 0;
+        for (auto &c : m_getLine(line).codes)
+        {
+            cols += std::max(0, c.cols);
+        }
+    }
+    return cols;
+}
+
+const LineWrap &ReflowIndex::Wrap(size_t line)
+{
+    auto &wrap = m_wraps[line];
+    if (!wrap)
+    {
+        wrap = std::make_unique<LineWrap>();
+        wrap->Build(m_getLine(line), m_wordWrap);
+    }
+    return *wrap;
+}
+
+uint32_t ReflowIndex::Rows(size_t line)
+{
+    auto &rows = m_rows[line];
+    if (rows)
+    {
+        return rows;
+    }
+    if (m_width <= 0 || Cols(line) <= (uint32_t)m_width)
+    {
+        // fits. no need to read the line again
+        rows = 1;
+    }
+    else
+    {
+        Wrap(line).Wrap(m_width, m_work);
+        rows = (uint32_t)m_work.size();
+    }
+    m_knownRows += rows;
+    --m_unknownLines;
+    return rows;
+}
+
+void ReflowIndex::Layout(size_t line, std::vector<WrapRow> &rows)
+{
+    if (Rows(line) == 1)
+    {
+        rows.assign(1, {0, 0});
+        return;
+    }
+    Wrap(line).Wrap(m_width, rows);
+}
+
+bool ReflowIndex::Step(size_t budget)
+{
+    for (; budget && m_unknownLines; --budget)
+    {
+        if (m_next == 0)
+        {
+            // lines appended after Resize
+            m_next = size();
+        }
+        Rows(--m_next);
+    }
+    return IsComplete();
+}
+
+void ReflowIndex::Move(size_t &line, uint32_t &row, int64_t rows)
+{
+    if (line >= size())
+    {
+        return;
+    }
+    row = std::min(row, Rows(line) - 1);
+    while (rows > 0)
+    {
+        auto below = Rows(line) - 1 - row;
+        if (rows <= below)
+        {
+            row += rows;
+            return;
+        }
+        if (line + 1 >= size())
+        {
+            row = Rows(line) - 1;
+            return;
+        }
+        rows -= below + 1;
+        ++line;
+        row = 0;
+    }
+    while (rows < 0)
+    {
+        if (-rows <= row)
+        {
+            row += rows;
+            return;
+        }
+        if (line == 0)
+        {
+            row = 0;
+            return;
+        }
+        rows += row + 1;
+        --line;
+        row = Rows(line) - 1;
+    }
+}
+
+size_t ReflowIndex::MemoryUsage() const
+{
+    auto size = (m_cols.capacity() + m_rows.capacity()) * sizeof(uint32_t) +
+                m_wraps.capacity() * sizeof(m_wraps[0]);
+    for (auto &wrap : m_wraps)
+    {
+        if (wrap)
+        {
+            size += sizeof(LineWrap) + wrap->MemoryUsage();
+        }
+    }
+    return size;
+}
+
+} // namespace termgrid
@@ -0,0 +1,142 @@
+#pragma once
+#include "termgrid.h"
+#include <memory>
+#include <vector>
+
+namespace termgrid
+{
+
+/// 折り返した 1 行の先頭
+struct WrapRow
+{
+    // codepoint index
+    uint32_t begin;
+    // column of begin in the unwrapped line
+    uint32_t col;
+};
+
+/// 1 行分の折り返し情報。幅に依存しないので resize しても作り直さない。
+///
+/// codepoint ごとの累積 column と折り返してよい位置を持つので、
+/// 幅を変えたときの折り返しは 1 行あたり O(rows * log n) で line を読まない。
+class LineWrap
+{
+    // m_colsAt[i]: columns before codepoint i. size() == codepoints + 1
+    std::vector<uint32_t> m_colsAt;
+    struct Break
+    {
+        // codepoint index where a row may begin
+        uint32_t index;
+        // right edge of the previous row. a trailing space does not count
+        uint32_t col;
+    };
+    // ascending
+    std::vector<Break> m_breaks;
+
+public:
+    /// wordWrap が false なら任意の文字境界で折り返す
+    void Build(const TermLine &line, bool wordWrap);
+
+    uint32_t cols() const
+    {
+        return m_colsAt.empty() ? 0 : m_colsAt.back();
+    }
+
+    size_t MemoryUsage() const
+    {
+        return m_colsAt.capacity() * sizeof(uint32_t) +
+               m_breaks.capacity() * sizeof(Break);
+    }
+
+    /// rows の先頭は常に {0, 0}
+    void Wrap(int width, std::vector<WrapRow> &rows) const;
+
+private:
+    WrapRow NextRow(const WrapRow &row, uint32_t limit) const;
+};
+
+/// 行の source を幅で折り返したときの行数を管理する。
+///
+/// 行ごとの幅 (columns) は初めて見たときに 1 回だけ計算して持つ。
+/// 幅に収まる行は resize しても 1 row のままなので line を読まない。
+/// 収まらない行だけ LineWrap を作って cache する。
+/// Resize は行数を未計算に戻すだけで、見えている行は Rows / Layout で
+/// その場で、残りは Step で少しずつ (event loop の idle などで) 計算する。
+class ReflowIndex
+{
+public:
+    using GetLineFunc = std::function<const TermLine &(size_t)>;
+
+private:
+    static constexpr uint32_t UNKNOWN = UINT32_MAX;
+
+    GetLineFunc m_getLine;
+    bool m_wordWrap;
+    int m_width = 0;
+
+    // width independent
+    std::vector<uint32_t> m_cols;
+    // only for lines that have ever been wider than the width
+    std::vector<std::unique_ptr<LineWrap>> m_wraps;
+
+    // for m_width. 0 is unknown
+    std::vector<uint32_t> m_rows;
+    // sum of known m_rows and count of unknown lines
+    uint64_t m_knownRows = 0;
+    size_t m_unknownLines = 0;
+    // Step walks from the newest line toward the oldest
+    size_t m_next = 0;
+
+    std::vector<WrapRow> m_work;
+
+public:
+    ReflowIndex(const GetLineFunc &getLine, bool wordWrap = true);
+
+    int width() const
+    {
+        return m_width;
+    }
+
+    size_t size() const
+    {
+        return m_cols.size();
+    }
+
+    /// source の行数が増えたら呼ぶ。追加分は未計算になる
+    void Sync(size_t lines);
+
+    /// 折り返し幅を変える。すべての行の行数を未計算に戻す
+    void Resize(int width);
+
+    /// 行 line の折り返し後の行数。未計算なら計算する
+    uint32_t Rows(size_t line);
+
+    /// 行 line を折り返した各行の先頭
+    void Layout(size_t line, std::vector<WrapRow> &rows);
+
+    /// 未計算の行を新しい方から最大 budget 行計算する。全部終わったら true
+    bool Step(size_t budget);
+
+    bool IsComplete() const
+    {
+        return m_unknownLines == 0;
+    }
+
+    /// 折り返し後の総行数。未完了なら未計算の行を 1 行として数えた概算
+    uint64_t TotalRows() const
+    {
+        return m_knownRows + m_unknownLines;
+    }
+
+    /// (line, row) から rows 行下 (負なら上) の位置。
+    /// 通る行だけ計算するので画面 1 枚分のコストで済む。端で止まる
+    void Move(size_t &line, uint32_t &row, int64_t rows);
+
+    size_t MemoryUsage() const;
+
+private:
+    uint32_t Cols(size_t line);
+    const LineWrap &Wrap(size_t line);
+};
+
+} // namespace termgrid
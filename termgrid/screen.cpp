@@ -0,0 +1,149 @@
+#include "screen.h"
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+
+namespace termgrid
+{
+
+bool IsSameCell(const TermCodepoint &l, const TermCodepoint &r)
+{
+    return l.cols == r.cols && l.flags == r.flags && l.fgcolor == r.fgcolor &&
+           l.bgcolor == r.bgcolor &&
+           l.cp.codeunit_count() == r.cp.codeunit_count() &&
+           memcmp(l.cp.data(), r.cp.data(), l.cp.codeunit_count()) == 0;
+}
+
+void FillCells(tcb::span<TermCodepoint> cells, const TermCodepoint &cell)
+{
+    if (cells.empty())
+    {
+        return;
+    }
+    cells[0] = cell;
+    // double the filled part
+    for (size_t n = 1; n < cells.size(); n *= 2)
+    {
+        std::copy_n(cells.data(), std::min(n, cells.size() - n),
+                    cells.data() + n);
+    }
+}
+
+TermCodepoint TermScreen::Blank()
+{
+    TermCodepoint cell{};
+    cell.cp = c8::utf8::codepoint(u8" ");
+    cell.cols = 1;
+    return cell;
+}
+
+void TermScreen::Resize(const TermSize &size)
+{
+    m_size = size;
+    m_cells.assign(size.width * size.height, Blank());
+    m_rows.resize(size.height);
+    std::iota(m_rows.begin(), m_rows.end(), 0);
+    m_dirtyRows.assign(size.height, 1);
+    m_versions.assign(size.height, 0);
+}
+
+void TermScreen::Set(int x, int y, const TermCodepoint &cell)
+{
+    auto &dst = m_cells[m_rows[y] * m_size.width + x];
+    if (!IsSameCell(dst, cell))
+    {
+        dst = cell;
+        m_dirtyRows[y] = 1;
+        m_versions[m_rows[y]] = 0;
+    }
+}
+
+void TermScreen::Blit(int x, int y, tcb::span<const TermCodepoint> codes,
+                      int width)
+{
+    if (y < 0 || y >= m_size.height)
+    {
+        return;
+    }
+    auto right = std::min(x + width, m_size.width);
+    for (auto &c : codes)
+    {
+        if (c.cols == 0)
+        {
+            continue;
+        }
+        if (x + c.cols > right)
+        {
+            break;
+        }
+        Set(x++, y, c);
+        for (int i = 1; i < c.cols; ++i)
+        {
+            // continuation
+            auto cont = c;
+            cont.cols = 0;
+            Set(x++, y, cont);
+        }
+    }
+    for (; x < right; ++x)
+    {
+        Set(x, y, Blank());
+    }
+}
+
+void TermScreen::GetLine(int y, TermLine &line) const
+{
+    auto &version = m_versions[m_rows[y]];
+    if (!version)
+    {
+        version = NewLineVersion();
+    }
+    line.clear();
+    line.version = version;
+    for (auto &c : Row(y))
+    {
+        if (c.cols)
+        {
+            line.codes.push_back(c);
+        }
+    }
+}
+
+void TermScreen::Scroll(int top, int bottom, int n,
+                        const TermCodepoint &blank)
+{
+    top = std::max(top, 0);
+    bottom = std::min(bottom, m_size.height - 1);
+    auto height = bottom - top + 1;
+    if (height <= 0 || n == 0)
+    {
+        return;
+    }
+    n = std::clamp(n, -height, height);
+
+    auto begin = m_rows.begin() + top;
+    auto end = m_rows.begin() + bottom + 1;
+    int first;
+    if (n > 0)
+    {
+        std::rotate(begin, begin + n, end);
+        first = bottom + 1 - n;
+    }
+    else
+    {
+        std::rotate(begin, end + n, end);
+        first = top;
+    }
+    for (int y = first; y < first + std::abs(n); ++y)
+    {
+        FillCells(EditRow(y), blank);
+    }
+    std::fill(m_dirtyRows.begin() + top, m_dirtyRows.begin() + bottom + 1, 1);
+}
+
+void TermScreen::ClearDirty()
+{
+    std::fill(m_dirtyRows.begin(), m_dirtyRows.end(), 0);
+}
+
+} // namespace termgrid
@@ -0,0 +1,85 @@
+#pragma once
+#include "termgrid.h"
+#include <vector>
+
+namespace termgrid
+{
+
+/// 端末の画面と同じ width x height の cell。headless の描画先。
+///
+/// 1 cell 1 codepoint。全角文字は 2 cell 目を cols == 0 の継続 cell にする。
+/// 合字の 0 column の codepoint は持たない。
+/// 行は m_rows で間接参照するので Scroll は cell を動かさない。
+/// GetLine の TermLine::version は m_cells の行ごとなので、scroll した行は同じ version のまま。
+class TermScreen
+{
+    TermSize m_size = {0, 0};
+    std::vector<TermCodepoint> m_cells;
+    // screen row to row in m_cells
+    std::vector<int> m_rows;
+    std::vector<uint8_t> m_dirtyRows;
+    // per row in m_cells. 0: changed. GetLine gives a new version
+    mutable std::vector<uint64_t> m_versions;
+
+public:
+    TermScreen() = default;
+    TermScreen(const TermSize &size)
+    {
+        Resize(size);
+    }
+
+    const TermSize &size() const
+    {
+        return m_size;
+    }
+
+    static TermCodepoint Blank();
+
+    // all cells blank and dirty
+    void Resize(const TermSize &size);
+
+    const TermCodepoint &Cell(int x, int y) const
+    {
+        return m_cells[m_rows[y] * m_size.width + x];
+    }
+
+    tcb::span<const TermCodepoint> Row(int y) const
+    {
+        return {m_cells.data() + m_rows[y] * m_size.width,
+                (size_t)m_size.width};
+    }
+
+    // mark row y dirty and return it for update
+    tcb::span<TermCodepoint> EditRow(int y)
+    {
+        m_dirtyRows[y] = 1;
+        m_versions[m_rows[y]] = 0;
+        return {m_cells.data() + m_rows[y] * m_size.width,
+                (size_t)m_size.width};
+    }
+
+    // mark row dirty if changed
+    void Set(int x, int y, const TermCodepoint &cell);
+
+    /// codes を (x, y) から width columns 分書く。余りは空白
+    void Blit(int x, int y, tcb::span<const TermCodepoint> codes, int width);
+
+    /// row を継続 cell を除いた TermLine にする
+    void GetLine(int y, TermLine &line) const;
+
+    /// rows [top, bottom] を n 行上に送る (n < 0 は下)。空いた行は blank
+    void Scroll(int top, int bottom, int n, const TermCodepoint &blank);
+
+    bool IsDirty(int y) const
+    {
+        return m_dirtyRows[y];
+    }
+    void ClearDirty();
+};
+
+bool IsSameCell(const TermCodepoint &l, const TermCodepoint &r);
+
+/// std::fill より速い。1 cell ずつ stack から写すと store forwarding が詰まる
+void FillCells(tcb::span<TermCodepoint> cells, const TermCodepoint &cell);
+
+} // namespace termgrid
@@ -0,0 +1,363 @@
+#include "scrollback.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <string.h>
+
+namespace termgrid
+{
+
+//
+// LZ4 block format. sequence = token, literals, offset, match
+//
+static const size_t MIN_MATCH = 4;
+static const int HASH_BITS = 12;
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static void push_length(std::vector<uint8_t> &out, size_t length)
+{
+    // length >= 15 continues
+    for (length -= 15; length >= 255; length -= 255)
+    {
+        out.push_back(255);
+    }
+    out.push_back((uint8_t)length);
+}
+
+static void push_sequence(std::vector<uint8_t> &out, const uint8_t *literals,
+                          size_t literalLength, size_t offset,
+                          size_t matchLength)
+{
+    auto m = matchLength ? matchLength - MIN_MATCH : 0;
+    out.push_back((uint8_t)((std::min<size_t>(literalLength, 15) << 4) |
+                            std::min<size_t>(m, 15)));
+    if (literalLength >= 15)
+    {
+        push_length(out, literalLength);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+    if (!matchLength)
+    {
+        // last literals
+        return;
+    }
+    out.push_back((uint8_t)offset);
+    out.push_back((uint8_t)(offset >> 8));
+    if (m >= 15)
+    {
+        push_length(out, m);
+    }
+}
+
+static void lz_compress(const uint8_t *src, size_t size,
+                        std::vector<uint8_t> &out)
+{
+    std::vector<uint32_t> table(1 << HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t ip = 0;
+    while (ip + MIN_MATCH <= size)
+    {
+        auto seq = read32(src + ip);
+        auto h = (seq * 2654435761u) >> (32 - HASH_BITS);
+        auto ref = table[h];
+        table[h] = (uint32_t)ip;
+        if (ref == UINT32_MAX || ip - ref > 0xFFFF || read32(src + ref) != seq)
+        {
+            ++ip;
+            continue;
+        }
+
+        auto length = MIN_MATCH;
+        while (ip + length < size && src[ref + length] == src[ip + length])
+        {
+            ++length;
+        }
+        push_sequence(out, src + anchor, ip - anchor, ip - ref, length);
+        ip += length;
+        anchor = ip;
+    }
+    push_sequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+static bool read_length(const uint8_t *&p, const uint8_t *end, size_t &length)
+{
+    while (true)
+    {
+        if (p >= end)
+        {
+            return false;
+        }
+        auto b = *p++;
+        length += b;
+        if (b != 255)
+        {
+            return true;
+        }
+    }
+}
+
+static bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst,
+                          size_t dstSize)
+{
+    auto p = src;
+    auto end = src + size;
+    size_t op = 0;
+    while (p < end)
+    {
+        auto token = *p++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !read_length(p, end, literalLength))
+        {
+            return false;
+        }
+        if (literalLength > (size_t)(end - p) ||
+            literalLength > dstSize - op)
+        {
+            return false;
+        }
+        memcpy(dst + op, p, literalLength);
+        p += literalLength;
+        op += literalLength;
+        if (p >= end)
+        {
+            break;
+        }
+
+        if (end - p < 2)
+        {
+            return false;
+        }
+        size_t offset = p[0] | (p[1] << 8);
+        p += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !read_length(p, end, matchLength))
+        {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > op || matchLength > dstSize - op)
+        {
+            return false;
+        }
+        // may overlap
+        for (size_t i = 0; i < matchLength; ++i, ++op)
+        {
+            dst[op] = dst[op - offset];
+        }
+    }
+    return op == dstSize;
+}
+
+static bool same_style(const TermCodepoint &l, const TermCodepoint &r)
+{
+    return l.cols == r.cols && l.flags == r.flags && l.fgcolor == r.fgcolor &&
+           l.bgcolor == r.bgcolor;
+}
+
+// frozen line: text bytes, run count, text, runs
+// run: codepoints, cols, flags, fgcolor, bgcolor
+static void freeze_line(std::vector<uint8_t> &out, const TermLine &line)
+{
+    uint32_t textBytes = 0;
+    uint32_t runs = 0;
+    for (size_t i = 0; i < line.codes.size(); ++i)
+    {
+        textBytes += line.codes[i].cp.codeunit_count();
+        if (i == 0 || !same_style(line.codes[i - 1], line.codes[i]))
+        {
+            ++runs;
+        }
+    }
+    push_varint(out, textBytes);
+    push_varint(out, runs);
+    for (auto &c : line.codes)
+    {
+        out.insert(out.end(), c.cp.data(), c.cp.data() + c.cp.codeunit_count());
+    }
+
+    size_t begin = 0;
+    for (size_t i = 1; i <= line.codes.size(); ++i)
+    {
+        if (i < line.codes.size() &&
+            same_style(line.codes[begin], line.codes[i]))
+        {
+            continue;
+        }
+        auto &c = line.codes[begin];
+        push_varint(out, i - begin);
+        push_varint(out, c.cols);
+        push_varint(out, c.flags);
+        push_color(out, c.fgcolor);
+        push_color(out, c.bgcolor);
+        begin = i;
+    }
+}
+
+// false if the block is broken
+static bool thaw_line(const uint8_t *&p, const uint8_t *end, TermLine &line)
+{
+    uint64_t textBytes, runs;
+    if (!read_varint(p, end, textBytes) || !read_varint(p, end, runs) ||
+        textBytes > (size_t)(end - p))
+    {
+        return false;
+    }
+    line.clear();
+    line.push((const char8_t *)p, textBytes);
+    p += textBytes;
+
+    size_t i = 0;
+    for (uint64_t r = 0; r < runs; ++r)
+    {
+        uint64_t count, cols, flags;
+        TermColor fg, bg;
+        if (!read_varint(p, end, count) || !read_varint(p, end, cols) ||
+            !read_varint(p, end, flags) || !read_color(p, end, fg) ||
+            !read_color(p, end, bg))
+        {
+            return false;
+        }
+        for (auto last = std::min<size_t>(i + count, line.codes.size()); i < last;
+             ++i)
+        {
+            auto &c = line.codes[i];
+            c.cols = cols;
+            c.flags = flags;
+            c.fgcolor = fg;
+            c.bgcolor = bg;
+        }
+    }
+    return true;
+}
+
+//
+// Scrollback
+//
+Scrollback::Scrollback(size_t hotLines, bool compress, size_t cacheBlocks)
+    : m_hotLines(hotLines), m_compress(compress),
+      m_cache(std::max<size_t>(1, cacheBlocks))
+{
+}
+
+TermLine &Scrollback::AppendLine()
+{
+    if (m_hot.size() >= m_hotLines + BLOCK_LINES)
+    {
+        Freeze();
+    }
+    m_hot.emplace_back();
+    return m_hot.back();
+}
+
+void Scrollback::Freeze()
+{
+    m_raw.clear();
+    for (size_t i = 0; i < BLOCK_LINES; ++i)
+    {
+        freeze_line(m_raw, m_hot.front());
+        m_hot.pop_front();
+    }
+
+    FrozenBlock block;
+    block.rawSize = (uint32_t)m_raw.size();
+    block.compressed = false;
+    if (m_compress)
+    {
+        lz_compress(m_raw.data(), m_raw.size(), block.data);
+        block.compressed = block.data.size() < m_raw.size();
+    }
+    if (!block.compressed)
+    {
+        block.data = m_raw;
+    }
+    block.data.shrink_to_fit();
+    m_frozen.push_back(std::move(block));
+}
+
+const std::vector<TermLine> &Scrollback::Thaw(size_t block)
+{
+    auto lru = &m_cache[0];
+    for (auto &cached : m_cache)
+    {
+        if (cached.block == block)
+        {
+            cached.used = ++m_useCount;
+            return cached.lines;
+        }
+        if (cached.used < lru->used)
+        {
+            lru = &cached;
+        }
+    }
+
+    auto &frozen = m_frozen[block];
+    const uint8_t *p = frozen.data.data();
+    const uint8_t *end = p + frozen.data.size();
+    bool ok = true;
+    if (frozen.compressed)
+    {
+        m_raw.resize(frozen.rawSize);
+        ok = lz_decompress(frozen.data.data(), frozen.data.size(),
+                           m_raw.data(), m_raw.size());
+        p = m_raw.data();
+        end = p + m_raw.size();
+    }
+
+    lru->block = block;
+    lru->used = ++m_useCount;
+    lru->lines.resize(BLOCK_LINES);
+    for (auto &line : lru->lines)
+    {
+        ok = ok && thaw_line(p, end, line);
+        if (!ok)
+        {
+            // broken block. empty lines, not garbage
+            line.clear();
+        }
+    }
+    if (!ok)
+    {
+        // not cached. thaw again next time
+        lru->block = SIZE_MAX;
+    }
+    return lru->lines;
+}
+
+const TermLine &Scrollback::Line(size_t index)
+{
+    auto frozenLines = m_frozen.size() * BLOCK_LINES;
+    if (index >= frozenLines)
+    {
+        return m_hot[index - frozenLines];
+    }
+    return Thaw(index / BLOCK_LINES)[index % BLOCK_LINES];
+}
+
+size_t Scrollback::MemoryUsage() const
+{
+    size_t size = 0;
+    for (auto &line : m_hot)
+    {
+        size += sizeof(TermLine) + line.codes.capacity() * sizeof(TermCodepoint);
+    }
+    for (auto &block : m_frozen)
+    {
+        size += sizeof(FrozenBlock) + block.data.capacity();
+    }
+    for (auto &cached : m_cache)
+    {
+        for (auto &line : cached.lines)
+        {
+            size +=
+                sizeof(TermLine) + line.codes.capacity() * sizeof(TermCodepoint);
+        }
+    }
+    return size;
+}
+
+} // namespace termgrid
@@ -0,0 +1,75 @@
+#pragma once
+#include "termgrid.h"
+#include <deque>
+#include <vector>
+
+namespace termgrid
+{
+
+/// 長い履歴用の行 store。
+///
+/// 新しい方の hot_lines 行は TermLine のまま持つ。それより古い行は
+/// BLOCK_LINES 行ずつ utf-8 の text と style の run-length に freeze し、
+/// (compress なら) LZ4 形式で圧縮する。
+/// freeze された行は Line で参照されたときに block 単位で展開して cache する。
+class Scrollback
+{
+public:
+    static const size_t BLOCK_LINES = 256;
+
+private:
+    struct FrozenBlock
+    {
+        std::vector<uint8_t> data;
+        uint32_t rawSize;
+        bool compressed;
+    };
+
+    struct CachedBlock
+    {
+        size_t block = SIZE_MAX;
+        uint64_t used = 0;
+        std::vector<TermLine> lines;
+    };
+
+    size_t m_hotLines;
+    bool m_compress;
+    std::vector<FrozenBlock> m_frozen;
+    std::deque<TermLine> m_hot;
+
+    std::vector<CachedBlock> m_cache;
+    uint64_t m_useCount = 0;
+    // work buffer for freeze/thaw
+    std::vector<uint8_t> m_raw;
+
+public:
+    /// cacheBlocks は 1 画面分の行を含めるだけ必要。0 は 1 にする
+    Scrollback(size_t hotLines = 1024, bool compress = true,
+               size_t cacheBlocks = 4);
+
+    size_t size() const
+    {
+        return m_frozen.size() * BLOCK_LINES + m_hot.size();
+    }
+
+    // clear the new line and return it
+    TermLine &AppendLine();
+
+    void Append(const TermLine &line)
+    {
+        AppendLine() = line;
+    }
+
+    /// 0 is the oldest. valid until an other block is thawed.
+    /// lines of a broken frozen block are empty
+    const TermLine &Line(size_t index);
+
+    // approximate bytes held
+    size_t MemoryUsage() const;
+
+private:
+    void Freeze();
+    const std::vector<TermLine> &Thaw(size_t block);
+};
+
+} // namespace termgrid
@@ -0,0 +1,172 @@
+#include "session.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+
+namespace termgrid
+{
+
+// front buffer values. row hash is always odd
+static const uint64_t BLANK_ROW = 0;
+static const uint64_t UNKNOWN_ROW = 2;
+
+static uint64_t hash_row(std::string_view body)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (auto c : body)
+    {
+        h ^= (uint8_t)c;
+        h *= 1099511628211ull;
+    }
+    return h | 1;
+}
+
+//
+// TermSnapshot
+//
+TermSnapshot::TermSnapshot(const TermScreen &screen) : m_size(screen.size())
+{
+    m_lines.resize(m_size.height);
+    m_bodies.resize(m_size.height);
+    m_hashes.resize(m_size.height);
+    TermLine line;
+    for (int y = 0; y < m_size.height; ++y)
+    {
+        screen.GetLine(y, line);
+        m_lines[y].Assign(line.codes, m_styles);
+        EncodeStyledLine(m_bodies[y], m_lines[y], m_styles, m_size.width);
+        m_hashes[y] = hash_row(m_bodies[y]);
+    }
+}
+
+//
+// TermSession
+//
+TermSession::TermSession(int fd, const char *term, const TermSize &size)
+    : m_entry(new TermcapEntry(term)), m_backend(DetectBackend(term, m_entry)),
+      m_writer(fd)
+{
+    Resize(size);
+}
+
+void TermSession::Resize(const TermSize &size)
+{
+    m_size = size;
+    m_front.assign(m_size.height, UNKNOWN_ROW);
+}
+
+template <typename B>
+void TermSession::Diff(const B &backend, const TermSnapshot &snapshot)
+{
+    auto height = std::min(m_size.height, snapshot.size().height);
+    // shared bytes if the row fits and colors match
+    auto shared = backend.colors == 256 && m_size.width >= snapshot.size().width;
+    for (int y = 0; y < m_size.height; ++y)
+    {
+        auto hash = y < height ? snapshot.Hash(y) : BLANK_ROW;
+        if (m_front[y] == hash)
+        {
+            continue;
+        }
+        backend.cursor_xy(m_frame, 0, y);
+        if (y < height)
+        {
+            if (shared)
+            {
+                m_frame.append(snapshot.Body(y));
+            }
+            else
+            {
+                backend.encode_styled_line(m_frame, snapshot.Line(y),
+                                           snapshot.styles(), m_size.width);
+            }
+        }
+        backend.clear_to_eol(m_frame);
+        m_front[y] = hash;
+    }
+}
+
+bool TermSession::Update(const TermSnapshot &snapshot)
+{
+    if (m_writer.IsBusy() && !m_writer.Flush())
+    {
+        // slow client. diff against the latest snapshot when drained
+        return false;
+    }
+
+    m_frame.clear();
+    {
+        TERMGRID_TRACE_SCOPE("session.diff");
+        std::visit([this, &snapshot](const auto &b) { Diff(b, snapshot); },
+                   m_backend);
+    }
+    if (m_frame.size())
+    {
+        m_writer.Submit(m_frame);
+        m_writer.Flush();
+    }
+    return true;
+}
+
+bool TermSession::Flush()
+{
+    return m_writer.Flush();
+}
+
+//
+// SessionServer
+//
+void SessionServer::Attach(const TermSessionPtr &session)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sessions.push_back(session);
+}
+
+void SessionServer::Detach(const TermSessionPtr &session)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find(m_sessions.begin(), m_sessions.end(), session);
+    if (it != m_sessions.end())
+    {
+        m_sessions.erase(it);
+    }
+}
+
+size_t SessionServer::size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sessions.size();
+}
+
+int SessionServer::Render(const TermSnapshotPtr &snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_rendering = m_sessions;
+    }
+
+    std::atomic<int> next = 0;
+    std::atomic<int> skipped = 0;
+    auto count = (int)m_rendering.size();
+    m_pool.Run([this, &snapshot, &next, &skipped, count](int) {
+        while (true)
+        {
+            auto i = next.fetch_add(1);
+            if (i >= count)
+            {
+                break;
+            }
+            if (!m_rendering[i]->Update(*snapshot))
+            {
+                ++skipped;
+            }
+        }
+    });
+
+    // keep no session alive after Detach
+    m_rendering.clear();
+    return skipped;
+}
+
+} // namespace termgrid
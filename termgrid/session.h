@@ -0,0 +1,123 @@
+#pragma once
+#include "backend.h"
+#include "screen.h"
+#include "tty_writer.h"
+#include "worker_pool.h"
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace termgrid
+{
+
+/// 全 session で共有する不変の frame。
+/// 行の encode (256 colors, 全幅) と hash は作るときに 1 回だけ。
+/// 行は style run で持ち、SGR は style id が変わるところでだけ出す。
+class TermSnapshot
+{
+    TermSize m_size;
+    // ids of m_lines. read only after the constructor
+    TermStyleTable m_styles;
+    std::vector<StyledLine> m_lines;
+    std::vector<std::string> m_bodies;
+    std::vector<uint64_t> m_hashes;
+
+public:
+    TermSnapshot(const TermScreen &screen);
+
+    const TermSize &size() const
+    {
+        return m_size;
+    }
+
+    const StyledLine &Line(int y) const
+    {
+        return m_lines[y];
+    }
+
+    const TermStyleTable &styles() const
+    {
+        return m_styles;
+    }
+
+    std::string_view Body(int y) const
+    {
+        return m_bodies[y];
+    }
+
+    uint64_t Hash(int y) const
+    {
+        return m_hashes[y];
+    }
+};
+using TermSnapshotPtr = std::shared_ptr<const TermSnapshot>;
+
+/// 1 つの端末への接続。fd, capability, size, front buffer を持つ。
+///
+/// front buffer は端末に表示済みの行の hash。前の frame を書き終わっていない
+/// 遅い session は frame を飛ばし、追いついたときに最新の snapshot との差分を送る。
+class TermSession
+{
+    TermcapEntryPtr m_entry;
+    AnyBackend m_backend;
+    TtyWriter m_writer;
+    TermSize m_size;
+    // empty: unknown. full redraw
+    std::vector<uint64_t> m_front;
+    std::string m_frame;
+
+public:
+    // fd is not owned. term: TERM of the client
+    TermSession(int fd, const char *term, const TermSize &size);
+
+    const TermSize &size() const
+    {
+        return m_size;
+    }
+
+    bool IsBusy() const
+    {
+        return m_writer.IsBusy();
+    }
+
+    // full redraw on next Update
+    void Resize(const TermSize &size);
+
+    /// snapshot との差分を書く。書き込みは non-blocking。
+    /// 前の frame が残っていれば false (frame は捨てる)
+    bool Update(const TermSnapshot &snapshot);
+
+    // write rest of the frame. true if drained
+    bool Flush();
+
+private:
+    template <typename B> void Diff(const B &backend, const TermSnapshot &snapshot);
+};
+using TermSessionPtr = std::shared_ptr<TermSession>;
+
+/// 1 つの snapshot を attach された全 session に描く。
+/// session ごとの差分作成と書き込みを WorkerPool で分担する。
+class SessionServer
+{
+    WorkerPool m_pool;
+    std::mutex m_mutex;
+    std::vector<TermSessionPtr> m_sessions;
+    // Render works on a copy. Attach/Detach from other threads
+    std::vector<TermSessionPtr> m_rendering;
+
+public:
+    // threads <= 0: hardware_concurrency
+    SessionServer(int threads = 0) : m_pool(threads)
+    {
+    }
+
+    void Attach(const TermSessionPtr &session);
+    void Detach(const TermSessionPtr &session);
+    size_t size();
+
+    /// return sessions skipped the frame
+    int Render(const TermSnapshotPtr &snapshot);
+};
+
+} // namespace termgrid
@@ -0,0 +1,201 @@
+#pragma once
+#include "style.h"
+#include "termgrid.h"
+#include <charconv>
+#include <string>
+
+namespace termgrid
+{
+namespace detail
+{
+
+inline void append_int(std::string &out, int value)
+{
+    char buf[16];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+}
+
+// 256 and 24bit color to ansi 8 color
+inline int to_ansi8(const TermColor &color)
+{
+    switch (color.type)
+    {
+    case TermColorTypes::Ansi:
+        return color.r & 7;
+
+    case TermColorTypes::Color256:
+        if (color.r < 16)
+        {
+            return color.r & 7;
+        }
+        if (color.r >= 232)
+        {
+            // gray
+            return color.r < 244 ? 0 : 7;
+        }
+        {
+            auto i = color.r - 16;
+            return (i / 36 > 2) | ((i / 6 % 6 > 2) << 1) | ((i % 6 > 2) << 2);
+        }
+
+    case TermColorTypes::Color24bit:
+        return (color.r > 127) | ((color.g > 127) << 1) | ((color.b > 127) << 2);
+
+    default:
+        return 0;
+    }
+}
+
+/// COLORS: 8 or 256. 8 なら 256 と 24bit color を近い ansi color にする
+template <int COLORS>
+inline void append_color(std::string &out, const TermColor &color, int base)
+{
+    if (COLORS < 256 && (color.type == TermColorTypes::Color256 ||
+                         color.type == TermColorTypes::Color24bit))
+    {
+        out.push_back(';');
+        append_int(out, base + to_ansi8(color));
+        return;
+    }
+
+    switch (color.type)
+    {
+    case TermColorTypes::Default:
+        break;
+
+    case TermColorTypes::Ansi:
+        out.push_back(';');
+        if (color.r < 8)
+        {
+            append_int(out, base + color.r);
+        }
+        else
+        {
+            // bright
+            append_int(out, base + 60 + (color.r & 7));
+        }
+        break;
+
+    case TermColorTypes::Color256:
+        out.push_back(';');
+        append_int(out, base + 8);
+        out.append(";5;");
+        append_int(out, color.r);
+        break;
+
+    case TermColorTypes::Color24bit:
+        out.push_back(';');
+        append_int(out, base + 8);
+        out.append(";2;");
+        append_int(out, color.r);
+        out.push_back(';');
+        append_int(out, color.g);
+        out.push_back(';');
+        append_int(out, color.b);
+        break;
+    }
+}
+
+template <int COLORS>
+inline void append_style(std::string &out, int flags, const TermColor &fgcolor,
+                         const TermColor &bgcolor)
+{
+    out.append("\033[0");
+    if (flags & (int)TermFlags::Bold)
+    {
+        out.append(";1");
+    }
+    if (flags & (int)TermFlags::Underline)
+    {
+        out.append(";4");
+    }
+    if (flags & (int)TermFlags::Standout)
+    {
+        out.append(";7");
+    }
+    append_color<COLORS>(out, fgcolor, 30);
+    append_color<COLORS>(out, bgcolor, 40);
+    out.push_back('m');
+}
+
+template <int COLORS>
+inline void append_sgr(std::string &out, const TermCodepoint &c)
+{
+    append_style<COLORS>(out, c.flags, c.fgcolor, c.bgcolor);
+}
+
+// encode cells until width. return used columns
+template <int COLORS = 256>
+inline int encode_cells(std::string &out, const TermCodepoint *p,
+                        const TermCodepoint *end, int width)
+{
+    TermCodepoint current{};
+    int x = 0;
+    for (; p != end; ++p)
+    {
+        if (x >= width || x + p->cols > width)
+        {
+            // over eol
+            break;
+        }
+        if (p->flags != current.flags || p->fgcolor != current.fgcolor ||
+            p->bgcolor != current.bgcolor)
+        {
+            append_sgr<COLORS>(out, *p);
+            current.flags = p->flags;
+            current.fgcolor = p->fgcolor;
+            current.bgcolor = p->bgcolor;
+        }
+        out.append((const char *)p->cp.data(), p->cp.codeunit_count());
+        x += p->cols;
+    }
+
+    if (current.flags || current.fgcolor != TermColor{} ||
+        current.bgcolor != TermColor{})
+    {
+        out.append("\033[0m");
+    }
+    return x;
+}
+
+// StyledLine version. style changes only at run boundaries and compares ids
+template <int COLORS = 256>
+inline int encode_runs(std::string &out, const StyledLine &line,
+                       const TermStyleTable &table, int width)
+{
+    TermStyleId current = 0;
+    int x = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < line.text.size(); ++i)
+    {
+        auto &c = line.text[i];
+        if (x >= width || x + c.cols > width)
+        {
+            // over eol
+            break;
+        }
+        if (next < line.runs.size() && line.runs[next].begin == i)
+        {
+            auto id = line.runs[next++].style;
+            if (id != current)
+            {
+                auto &style = table.Get(id);
+                append_style<COLORS>(out, style.flags, style.fgcolor,
+                                     style.bgcolor);
+                current = id;
+            }
+        }
+        out.append((const char *)c.cp.data(), c.cp.codeunit_count());
+        x += c.cols;
+    }
+
+    if (current != 0)
+    {
+        out.append("\033[0m");
+    }
+    return x;
+}
+
+} // namespace detail
+} // namespace termgrid
@@ -0,0 +1,81 @@
+#include "style.h"
+#include <algorithm>
+
+namespace termgrid
+{
+
+static uint32_t color_bits(const TermColor &c)
+{
+    return c.r | (c.g << 8) | (c.b << 16) | ((uint32_t)c.type << 24);
+}
+
+size_t TermStyleTable::Hash::operator()(const TermStyle &s) const
+{
+    uint64_t h = ((uint64_t)color_bits(s.fgcolor) << 32) | color_bits(s.bgcolor);
+    return std::hash<uint64_t>()(h ^ ((uint64_t)s.flags * 0x9E3779B97F4A7C15ull));
+}
+
+TermStyleTable::TermStyleTable()
+{
+    // id 0
+    Intern({});
+}
+
+TermStyleId TermStyleTable::Intern(const TermStyle &style)
+{
+    auto [it, inserted] = m_ids.try_emplace(style, (TermStyleId)m_styles.size());
+    if (inserted)
+    {
+        m_styles.push_back(style);
+    }
+    return it->second;
+}
+
+void StyledLine::Assign(tcb::span<const TermCodepoint> codes,
+                        TermStyleTable &table)
+{
+    clear();
+    text.reserve(codes.size());
+    TermStyle current{};
+    TermStyleId id = 0;
+    for (auto &c : codes)
+    {
+        auto style = GetStyle(c);
+        if (!(style == current))
+        {
+            current = style;
+            id = table.Intern(style);
+        }
+        push({c.cp, c.cols}, id);
+    }
+}
+
+TermStyleId StyledLine::StyleAt(size_t i) const
+{
+    auto it = std::upper_bound(
+        runs.begin(), runs.end(), i,
+        [](size_t i, const TermStyleRun &run) { return i < run.begin; });
+    if (it == runs.begin())
+    {
+        return 0;
+    }
+    return (it - 1)->style;
+}
+
+void StyledLine::ToLine(TermLine &line, const TermStyleTable &table) const
+{
+    line.clear();
+    line.codes.reserve(text.size());
+    for (size_t r = 0; r < runs.size(); ++r)
+    {
+        auto &style = table.Get(runs[r].style);
+        auto end = r + 1 < runs.size() ? runs[r + 1].begin : text.size();
+        for (auto i = runs[r].begin; i < end; ++i)
+        {
+            line.codes.push_back({text[i].cp, text[i].cols, style.flags,
+                                  style.fgcolor, style.bgcolor});
+        }
+    }
+}
+
+} // namespace termgrid
@@ -0,0 +1,105 @@
+#pragma once
+#include "termgrid.h"
+#include <unordered_map>
+#include <vector>
+
+namespace termgrid
+{
+
+/// cell の属性。TermCodepoint の flags, fgcolor, bgcolor と同じ
+struct TermStyle
+{
+    int flags;
+    TermColor fgcolor;
+    TermColor bgcolor;
+
+    bool operator==(const TermStyle &) const = default;
+};
+
+inline TermStyle GetStyle(const TermCodepoint &c)
+{
+    return {c.flags, c.fgcolor, c.bgcolor};
+}
+
+/// 0 is the default style
+using TermStyleId = uint32_t;
+
+/// style を id に intern する。同じ style は同じ id なので比較は id だけでよい
+class TermStyleTable
+{
+    struct Hash
+    {
+        size_t operator()(const TermStyle &s) const;
+    };
+    std::vector<TermStyle> m_styles;
+    std::unordered_map<TermStyle, TermStyleId, Hash> m_ids;
+
+public:
+    TermStyleTable();
+
+    TermStyleId Intern(const TermStyle &style);
+
+    const TermStyle &Get(TermStyleId id) const
+    {
+        return m_styles[id];
+    }
+
+    size_t size() const
+    {
+        return m_styles.size();
+    }
+};
+
+/// 属性のない cell
+struct TermChar
+{
+    c8::utf8::codepoint cp;
+    int cols;
+};
+
+/// text[begin] から次の run の begin まで同じ style
+struct TermStyleRun
+{
+    uint32_t begin;
+    TermStyleId style;
+};
+
+/// 属性を cell ごとではなく run で持つ行。
+/// 白黒の行なら run は 1 つ。
+/// LogPane と TermSnapshot (session の差分) がこれで行を持つ。
+/// TermLine, TermScreen, compositor は TermCodepoint の cell ごとの属性のまま。
+struct StyledLine
+{
+    std::vector<TermChar> text;
+    std::vector<TermStyleRun> runs;
+
+    void clear()
+    {
+        text.clear();
+        runs.clear();
+    }
+
+    size_t size() const
+    {
+        return text.size();
+    }
+
+    void push(const TermChar &c, TermStyleId style)
+    {
+        if (runs.empty() || runs.back().style != style)
+        {
+            runs.push_back({(uint32_t)text.size(), style});
+        }
+        text.push_back(c);
+    }
+
+    // intern once per run
+    void Assign(tcb::span<const TermCodepoint> codes, TermStyleTable &table);
+
+    // O(log runs)
+    TermStyleId StyleAt(size_t i) const;
+
+    void ToLine(TermLine &line, const TermStyleTable &table) const;
+};
+
+} // namespace termgrid
@@ -3,6 +3,7 @@
 #include <string>
 #include <unistd.h> // isatty
 #include <iostream>
+#include <mutex>
 #include <thread>
 
 extern "C" int tgetent(const char *, const char *);
@@ -22,6 +23,26 @@ static std::string_view getstr(const char *name)
     return func;
 }
 
+// termcap keeps the loaded entry and the tgoto result in globals.
+// every call into it holds this lock, so entries can be used from any thread
+static std::mutex s_termcap;
+
+static thread_local std::string *s_out = nullptr;
+
+static int putc_buffer(int c)
+{
+    s_out->push_back((char)c);
+    return c;
+}
+
+// s_termcap must be locked
+static void tputs_buffer(std::string &out, const char *str)
+{
+    s_out = &out;
+    tputs(str, 1, putc_buffer);
+    s_out = nullptr;
+}
+
 namespace termgrid
 {
 
@@ -57,9 +78,17 @@ struct TermcapEntryImpl
     std::string op; /* set default color pair to its original value */
     std::string vi;
     std::string ve;
+    std::string cs; /* change scroll region */
+    std::string sf; /* scroll forward */
+    std::string SF; /* scroll forward n lines */
+    // copied. tgetnum answers for the last loaded entry
+    int co = 0;
+    int li = 0;
+    int Co = 0;
 
     TermcapEntryImpl(const char *term)
     {
+        std::lock_guard<std::mutex> lock(s_termcap);
         char buffer[1024];
         auto e = tgetent(buffer, term);
         if (!e)
@@ -114,6 +143,16 @@ struct TermcapEntryImpl
         op = getstr("op"); /* set default color pair to its original value */
         vi = getstr("vi");
         ve = getstr("ve");
+        cs = getstr("cs"); /* change scroll region */
+        sf = getstr("sf"); /* scroll forward */
+        if (sf.empty())
+        {
+            sf = "\n";
+        }
+        SF = getstr("SF"); /* scroll forward n lines */
+        co = tgetnum("co");
+        li = tgetnum("li");
+        Co = tgetnum("Co");
     }
 };
 
@@ -151,42 +190,53 @@ TermcapEntryPtr TermcapEntry::create_from_env()
 
 void TermcapEntry::clear()
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     tputs(m_impl->cl.c_str(), 1, putchar);
 }
 
 void TermcapEntry::clear_to_eol()
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     tputs(m_impl->ce.c_str(), 1, putchar);
 }
 
 int TermcapEntry::lines() const
 {
-    return tgetnum("li");
+    return m_impl->li;
 }
 
 int TermcapEntry::columns() const
 {
-    return tgetnum("co");
+    return m_impl->co;
+}
+
+int TermcapEntry::colors() const
+{
+    return m_impl->Co;
 }
 
 void TermcapEntry::cursor_xy(int col, int line)
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     auto s = tgoto(m_impl->cm.c_str(), col, line);
     tputs(s, 1, putchar);
 }
 
 void TermcapEntry::cursor_save()
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     tputs(m_impl->sc.c_str(), 1, putchar);
 }
 
 void TermcapEntry::cursor_restore()
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     tputs(m_impl->rc.c_str(), 1, putchar);
 }
 
 void TermcapEntry::cursor_show(bool enable)
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     if (enable)
     {
         tputs(m_impl->ve.c_str(), 1, putchar);
@@ -199,6 +249,7 @@ void TermcapEntry::cursor_show(bool enable)
 
 void TermcapEntry::standout(bool enable)
 {
+    std::lock_guard<std::mutex> lock(s_termcap);
     if (enable)
     {
         tputs(m_impl->so.c_str(), 1, putchar);
@@ -209,6 +260,54 @@ void TermcapEntry::standout(bool enable)
     }
 }
 
+void TermcapEntry::cursor_xy(std::string &out, int col, int line)
+{
+    std::lock_guard<std::mutex> lock(s_termcap);
+    auto s = tgoto(m_impl->cm.c_str(), col, line);
+    tputs_buffer(out, s);
+}
+
+void TermcapEntry::clear_to_eol(std::string &out)
+{
+    std::lock_guard<std::mutex> lock(s_termcap);
+    tputs_buffer(out, m_impl->ce.c_str());
+}
+
+void TermcapEntry::cursor_show(std::string &out, bool enable)
+{
+    std::lock_guard<std::mutex> lock(s_termcap);
+    tputs_buffer(out, enable ? m_impl->ve.c_str() : m_impl->vi.c_str());
+}
+
+void TermcapEntry::standout(std::string &out, bool enable)
+{
+    std::lock_guard<std::mutex> lock(s_termcap);
+    tputs_buffer(out, enable ? m_impl->so.c_str() : m_impl->se.c_str());
+}
+
+void TermcapEntry::scroll_region(std::string &out, int top, int bottom)
+{
+    std::lock_guard<std::mutex> lock(s_termcap);
+    // tgoto(cap, col, row) passes row first
+    auto s = tgoto(m_impl->cs.c_str(), bottom, top);
+    tputs_buffer(out, s);
+}
+
+void TermcapEntry::scroll_forward(std::string &out, int n)
+{
+    std::lock_guard<std::mutex> lock(s_termcap);
+    if (n > 1 && !m_impl->SF.empty())
+    {
+        auto s = tgoto(m_impl->SF.c_str(), 0, n);
+        tputs_buffer(out, s);
+        return;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        tputs_buffer(out, m_impl->sf.c_str());
+    }
+}
+
 std::tuple<int, int> TermcapEntry::cursor_xy() const
 {
     char buf[32] = {0};
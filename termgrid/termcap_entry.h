@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <string>
 
 namespace termgrid {
 struct TermcapEntry
@@ -18,6 +19,8 @@ struct TermcapEntry
     void clear_to_eol();
     int lines() const;
     int columns() const;
+    // terminfo colors (Co). -1 if not defined
+    int colors() const;
     void cursor_xy(int col, int line);
     void cursor_save();
     void cursor_restore();
@@ -25,6 +28,16 @@ struct TermcapEntry
     void standout(bool enable);
 
     std::tuple<int, int> cursor_xy()const;
+
+    // append to buffer instead of putchar
+    void cursor_xy(std::string &out, int col, int line);
+    void clear_to_eol(std::string &out);
+    void cursor_show(std::string &out, bool enable);
+    void standout(std::string &out, bool enable);
+    // rows [top, bottom] scroll. resets cursor position
+    void scroll_region(std::string &out, int top, int bottom);
+    // scroll up the scroll region n lines. cursor must be in the region
+    void scroll_forward(std::string &out, int n);
 };
 using TermcapEntryPtr = std::shared_ptr<termgrid::TermcapEntry>;
 
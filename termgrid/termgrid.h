@@ -1,6 +1,9 @@
 #pragma once
+#include <atomic>
 #include <char8/char8.hpp>
 #include <functional>
+#include <memory_resource>
+#include <vector>
 #include <tcb/span.hpp>
 
 namespace termgrid
@@ -18,16 +21,31 @@ struct TermSize
     int height;
 };
 
-// struct TermRect
-// {
-//     int left;
-//     int top;
-//     int width;
-//     int height;
-// };
+struct TermRect
+{
+    int left;
+    int top;
+    int width;
+    int height;
+
+    int right() const
+    {
+        return left + width;
+    }
+    int bottom() const
+    {
+        return top + height;
+    }
+    bool empty() const
+    {
+        return width <= 0 || height <= 0;
+    }
+};
 
 enum class TermColorTypes : uint8_t
 {
+    // terminal default. zero initialized TermColor
+    Default,
     Ansi,
     Color256,
     Color24bit,
@@ -39,9 +57,20 @@ struct TermColor
     uint8_t g;
     uint8_t b;
     TermColorTypes type;
+
+    bool operator==(const TermColor &) const = default;
 };
 static_assert(sizeof(TermColor) == 4, "TermColor.sizeof");
 
+/// TermCodepoint::flags
+enum class TermFlags : int
+{
+    None = 0,
+    Bold = 0x01,
+    Underline = 0x02,
+    Standout = 0x04,
+};
+
 /// TermCell にしようと思っていたが可変長になって表現できなかった
 ///
 /// 1コードポイントで1cel: 半角文字
@@ -67,13 +96,55 @@ struct TermCodepoint
     TermColor bgcolor;
 };
 
+/// 0 以外の process 内で一意な値
+inline uint64_t NewLineVersion()
+{
+    static std::atomic<uint64_t> s_version = 0;
+    return ++s_version;
+}
+
+/// allocator_type を持つので std::pmr container に入れると同じ memory_resource を使う
 struct TermLine
 {
-    std::vector<TermCodepoint> codes;
+    using allocator_type = std::pmr::polymorphic_allocator<TermCodepoint>;
+
+    std::pmr::vector<TermCodepoint> codes;
+    /// 内容の version。同じ version なら同じ内容なので encode 結果を使い回せる。
+    /// 0 は不明 (cache しない)。clear, push は 0 に戻す。
+    /// codes を直接変えたら Touch する。copy すると一緒に写る
+    uint64_t version = 0;
+
+    TermLine() = default;
+    explicit TermLine(const allocator_type &alloc) : codes(alloc)
+    {
+    }
+    TermLine(const TermLine &rhs, const allocator_type &alloc)
+        : codes(rhs.codes, alloc), version(rhs.version)
+    {
+    }
+    TermLine(TermLine &&rhs, const allocator_type &alloc)
+        : codes(std::move(rhs.codes), alloc), version(rhs.version)
+    {
+    }
+    TermLine(const TermLine &) = default;
+    TermLine(TermLine &&) = default;
+    TermLine &operator=(const TermLine &) = default;
+    TermLine &operator=(TermLine &&) = default;
+
+    allocator_type get_allocator() const
+    {
+        return codes.get_allocator();
+    }
 
     void clear()
     {
         codes.clear();
+        version = 0;
+    }
+
+    void Touch()
+    {
+        version = NewLineVersion();
     }
 
     using GetColsFunc = const std::function<int(char32_t)>;
@@ -90,6 +161,7 @@ struct TermLine
             }
         }
 
+        version = 0;
         auto before = codes.size();
         for (int i = 0; i < size;)
         {
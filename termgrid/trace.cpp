@@ -0,0 +1,181 @@
+#include "trace.h"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace termgrid
+{
+
+// events per thread
+static const size_t RING_SIZE = 1 << 15;
+
+// single writer. readers check seq around the copy
+struct TraceRing
+{
+    struct Slot
+    {
+        // 2 * index + 1 while writing, 2 * index + 2 when done
+        std::atomic<uint64_t> seq{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> begin{0};
+        std::atomic<uint64_t> duration{0};
+    };
+
+    std::unique_ptr<Slot[]> slots{new Slot[RING_SIZE]};
+    std::atomic<uint64_t> head{0};
+    int tid;
+    std::atomic<const char *> name{nullptr};
+};
+
+static std::mutex s_mutex;
+// never freed. a thread may exit before the dump
+static std::vector<TraceRing *> s_rings;
+static thread_local TraceRing *t_ring = nullptr;
+
+static TraceRing *get_ring()
+{
+    if (!t_ring)
+    {
+        t_ring = new TraceRing;
+        t_ring->tid = (int)syscall(SYS_gettid);
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_rings.push_back(t_ring);
+    }
+    return t_ring;
+}
+
+uint64_t TraceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void TraceRecord(const char *name, uint64_t begin, uint64_t end)
+{
+    auto ring = get_ring();
+    auto i = ring->head.load(std::memory_order_relaxed);
+    auto &slot = ring->slots[i % RING_SIZE];
+    slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.duration.store(end - begin, std::memory_order_relaxed);
+    slot.seq.store(2 * i + 2, std::memory_order_release);
+    ring->head.store(i + 1, std::memory_order_release);
+}
+
+void TraceThreadName(const char *name)
+{
+    get_ring()->name.store(name, std::memory_order_relaxed);
+}
+
+static void append_int(std::string &out, uint64_t value)
+{
+    char buf[24];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+}
+
+// ns to us with 3 decimals
+static void append_us(std::string &out, uint64_t ns)
+{
+    append_int(out, ns / 1000);
+    auto frac = ns % 1000;
+    out.push_back('.');
+    out.push_back('0' + frac / 100);
+    out.push_back('0' + frac / 10 % 10);
+    out.push_back('0' + frac % 10);
+}
+
+static void append_string(std::string &out, const char *s)
+{
+    out.push_back('"');
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            out.push_back('\\');
+        }
+        out.push_back(*s);
+    }
+    out.push_back('"');
+}
+
+static void append_head(std::string &out, bool &first, int pid, int tid)
+{
+    out.append(first ? "\n" : ",\n");
+    first = false;
+    out.append("{\"pid\":");
+    append_int(out, pid);
+    out.append(",\"tid\":");
+    append_int(out, tid);
+}
+
+void DumpTrace(std::string &out)
+{
+    std::vector<TraceRing *> rings;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        rings = s_rings;
+    }
+
+    auto pid = (int)getpid();
+    bool first = true;
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (auto ring : rings)
+    {
+        if (auto name = ring->name.load(std::memory_order_relaxed))
+        {
+            append_head(out, first, pid, ring->tid);
+            out.append(",\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":");
+            append_string(out, name);
+            out.append("}}");
+        }
+
+        auto head = ring->head.load(std::memory_order_acquire);
+        auto i = head > RING_SIZE ? head - RING_SIZE : 0;
+        for (; i < head; ++i)
+        {
+            auto &slot = ring->slots[i % RING_SIZE];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto name = slot.name.load(std::memory_order_relaxed);
+            auto begin = slot.begin.load(std::memory_order_relaxed);
+            auto duration = slot.duration.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq != 2 * i + 2 ||
+                slot.seq.load(std::memory_order_relaxed) != seq)
+            {
+                // overwritten while reading
+                continue;
+            }
+
+            append_head(out, first, pid, ring->tid);
+            out.append(",\"ph\":\"X\",\"cat\":\"termgrid\",\"name\":");
+            append_string(out, name);
+            out.append(",\"ts\":");
+            append_us(out, begin);
+            out.append(",\"dur\":");
+            append_us(out, duration);
+            out.push_back('}');
+        }
+    }
+    out.append("\n]}\n");
+}
+
+bool WriteTrace(const char *path)
+{
+    std::string json;
+    DumpTrace(json);
+    std::ofstream os(path, std::ios::binary);
+    os.write(json.data(), json.size());
+    return (bool)os;
+}
+
+} // namespace termgrid
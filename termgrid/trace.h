@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+namespace termgrid
+{
+
+/// 区間計測を Chrome trace-event JSON (Perfetto で開ける) で書き出す。
+///
+/// TERMGRID_TRACE_SCOPE, TERMGRID_TRACE_THREAD_NAME は TERMGRID_TRACE を定義して
+/// build したときだけ有効で、そうでなければ何も残らない (ring も確保しない)。
+/// 区間は thread ごとの ring buffer に lock なしで書く。
+/// ring が一周したら古い区間から上書きし、WriteTrace はその時点で残っている区間を書く。
+
+// ns. steady clock
+uint64_t TraceNow();
+
+/// name は string literal。pointer だけ持つ
+void TraceRecord(const char *name, uint64_t begin, uint64_t end);
+
+/// 呼んだ thread の名前。string literal
+void TraceThreadName(const char *name);
+
+/// 全 thread の区間を trace-event JSON にして out に追記する。
+/// 記録中の thread があってもよい
+void DumpTrace(std::string &out);
+
+bool WriteTrace(const char *path);
+
+class TraceScope
+{
+    const char *m_name;
+    uint64_t m_begin;
+
+public:
+    explicit TraceScope(const char *name) : m_name(name), m_begin(TraceNow())
+    {
+    }
+    ~TraceScope()
+    {
+        TraceRecord(m_name, m_begin, TraceNow());
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+};
+
+} // namespace termgrid
+
+#define TERMGRID_TRACE_CONCAT_(a, b) a##b
+#define TERMGRID_TRACE_CONCAT(a, b) TERMGRID_TRACE_CONCAT_(a, b)
+
+#ifdef TERMGRID_TRACE
+#define TERMGRID_TRACE_SCOPE(name)                                             \
+    ::termgrid::TraceScope TERMGRID_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TERMGRID_TRACE_THREAD_NAME(name) ::termgrid::TraceThreadName(name)
+#else
+#define TERMGRID_TRACE_SCOPE(name) ((void)0)
+#define TERMGRID_TRACE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,96 @@
+#include "tty_writer.h"
+#include "trace.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace termgrid
+{
+
+TtyWriter::TtyWriter(int fd)
+{
+    // own open file description. O_NONBLOCK does not leak to stdin/stdout
+    if (auto name = ttyname(fd))
+    {
+        m_fd = open(name, O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    }
+    if (m_fd < 0)
+    {
+        // shares the file description with fd. keep it blocking
+        m_fd = dup(fd);
+        m_shared = true;
+    }
+}
+
+TtyWriter::~TtyWriter()
+{
+    Drain();
+    close(m_fd);
+}
+
+bool TtyWriter::Submit(std::string &frame)
+{
+    if (IsBusy())
+    {
+        return false;
+    }
+    m_frame.swap(frame);
+    frame.clear();
+    m_written = 0;
+    return true;
+}
+
+bool TtyWriter::Flush()
+{
+    TERMGRID_TRACE_SCOPE("tty.write");
+    while (IsBusy())
+    {
+        auto size = Pending();
+        if (m_shared)
+        {
+            // a blocking write of PIPE_BUF does not block when POLLOUT
+            pollfd p = {m_fd, POLLOUT, 0};
+            auto ready = poll(&p, 1, 0);
+            if (ready < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ready == 0)
+            {
+                return false;
+            }
+            size = std::min<size_t>(size, PIPE_BUF);
+        }
+        auto n = write(m_fd, m_frame.data() + m_written, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return false;
+            }
+            // drop. fd is gone
+            m_written = m_frame.size();
+            break;
+        }
+        m_written += n;
+    }
+    return true;
+}
+
+void TtyWriter::Drain()
+{
+    while (!Flush())
+    {
+        pollfd p = {m_fd, POLLOUT, 0};
+        poll(&p, 1, -1);
+    }
+}
+
+} // namespace termgrid
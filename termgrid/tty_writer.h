@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+
+namespace termgrid
+{
+
+/// 端末への non-blocking な出力。
+///
+/// 書き込み中の frame は 1 つだけ持つ。書き終わる前の Submit は失敗するので、
+/// 呼び出し側は状態を dirty にしておき、書き終わってから最新の状態で frame を作る
+/// (途中の frame は捨てる)。
+class TtyWriter
+{
+    int m_fd = -1;
+    // dup of a shared description. stays blocking, poll before each write
+    bool m_shared = false;
+    std::string m_frame;
+    size_t m_written = 0;
+
+public:
+    /// fd is not owned. 端末なら名前で開き直した自前の non-blocking な description に書く。
+    /// 開けなければ (pipe など) dup して blocking のまま共有し、
+    /// poll で書けるときだけ PIPE_BUF ずつ書く。O_NONBLOCK は他の fd に漏れない
+    TtyWriter(int fd = 1);
+    ~TtyWriter();
+    TtyWriter(const TtyWriter &) = delete;
+    TtyWriter &operator=(const TtyWriter &) = delete;
+
+    int fd() const
+    {
+        return m_fd;
+    }
+
+    bool IsBusy() const
+    {
+        return m_written < m_frame.size();
+    }
+
+    size_t Pending() const
+    {
+        return m_frame.size() - m_written;
+    }
+
+    /// 前の frame が書き終わっていなければ false。
+    /// frame とは buffer を交換するので呼び出し側は capacity を使いまわせる
+    bool Submit(std::string &frame);
+
+    // write without blocking. true if drained, false to wait writable
+    bool Flush();
+
+    // blocking
+    void Drain();
+};
+
+} // namespace termgrid
@@ -0,0 +1,971 @@
+#include "vt_parser.h"
+#include <algorithm>
+#include <array>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace termgrid
+{
+
+static const int TAB_COLS = 8;
+
+static const std::array<c8::utf8::codepoint, 128> &ascii_table()
+{
+    static std::array<c8::utf8::codepoint, 128> s_table = [] {
+        std::array<c8::utf8::codepoint, 128> table;
+        for (int i = 0; i < 128; ++i)
+        {
+            char8_t c = i;
+            table[i] = c8::utf8::codepoint(&c);
+        }
+        return table;
+    }();
+    return s_table;
+}
+
+// length of printable ascii run from p
+static size_t scan_printable(const char *p, const char *end)
+{
+    auto begin = p;
+#ifdef __SSE2__
+    auto space = _mm_set1_epi8(0x20);
+    auto del = _mm_set1_epi8(0x7F);
+    for (; p + 16 <= end; p += 16)
+    {
+        auto v = _mm_loadu_si128((const __m128i *)p);
+        // signed compare: >= 0x80 is negative and less than space too
+        auto stop = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                                 _mm_cmpeq_epi8(v, del));
+        unsigned mask = _mm_movemask_epi8(stop);
+        if (mask)
+        {
+            return p - begin + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; p < end; ++p)
+    {
+        auto c = (unsigned char)*p;
+        if (c < 0x20 || c >= 0x7F)
+        {
+            break;
+        }
+    }
+    return p - begin;
+}
+
+// 0 if invalid lead byte
+static int utf8_lead_length(unsigned char c)
+{
+    if ((c & 0xE0) == 0xC0)
+    {
+        return 2;
+    }
+    if ((c & 0xF0) == 0xE0)
+    {
+        return 3;
+    }
+    if ((c & 0xF8) == 0xF0)
+    {
+        return 4;
+    }
+    return 0;
+}
+
+static TermCodepoint replacement()
+{
+    TermCodepoint cell{};
+    cell.cp = c8::utf8::codepoint(u8"�");
+    cell.cols = 1;
+    return cell;
+}
+
+VtParser::VtParser(TermScreen &screen, const TermLine::GetColsFunc &getCols)
+    : m_screen(&screen), m_getCols(getCols)
+{
+    m_pen = {};
+    m_saved = {0, 0, m_pen};
+    Resize();
+}
+
+void VtParser::Resize()
+{
+    auto &size = m_screen->size();
+    m_x = std::clamp(m_x, 0, std::max(size.width - 1, 0));
+    m_y = std::clamp(m_y, 0, std::max(size.height - 1, 0));
+    m_top = 0;
+    m_bottom = size.height - 1;
+    m_wrapPending = false;
+}
+
+void VtParser::Reset()
+{
+    m_state = States::Ground;
+    m_utf8Size = 0;
+    m_pen = {};
+    m_x = 0;
+    m_y = 0;
+    m_autoWrap = true;
+    m_cursorVisible = true;
+    m_saved = {0, 0, m_pen};
+    Resize();
+    for (int y = 0; y < m_screen->size().height; ++y)
+    {
+        EraseCells(y, 0, m_screen->size().width);
+    }
+}
+
+TermCodepoint VtParser::Blank() const
+{
+    auto cell = TermScreen::Blank();
+    // background color erase
+    cell.bgcolor = m_pen.bgcolor;
+    return cell;
+}
+
+void VtParser::Feed(std::string_view data)
+{
+    auto &size = m_screen->size();
+    if (size.width <= 0 || size.height <= 0)
+    {
+        return;
+    }
+
+    auto p = data.data();
+    auto end = p + data.size();
+
+    // complete utf-8 split by the previous Feed
+    while (m_utf8Size && p < end)
+    {
+        auto c = (unsigned char)*p;
+        if ((c & 0xC0) != 0x80)
+        {
+            Print(replacement());
+            m_utf8Size = 0;
+            break;
+        }
+        m_utf8[m_utf8Size++] = *p++;
+        if (m_utf8Size == utf8_lead_length(m_utf8[0]))
+        {
+            TermCodepoint cell{};
+            cell.cp = c8::utf8::codepoint((const char8_t *)m_utf8);
+            cell.cols = m_getCols(cell.cp.to_unicode());
+            Print(cell);
+            m_utf8Size = 0;
+        }
+    }
+
+    while (p < end)
+    {
+        auto c = *p;
+        switch (m_state)
+        {
+        case States::Ground:
+            p += Ground(p, end);
+            break;
+
+        case States::Escape:
+            ++p;
+            m_state = States::Ground;
+            Escape(c);
+            break;
+
+        case States::Charset:
+            ++p;
+            m_state = States::Ground;
+            break;
+
+        case States::Csi:
+            ++p;
+            if (c >= '0' && c <= '9')
+            {
+                auto &param = m_params[m_paramCount - 1];
+                param = std::min(param * 10 + (c - '0'), 0xFFFF);
+            }
+            else if (c == ';' || c == ':')
+            {
+                if (m_paramCount < MAX_PARAMS)
+                {
+                    m_params[m_paramCount++] = 0;
+                }
+            }
+            else if (c >= 0x3C && c <= 0x3F)
+            {
+                m_private = c;
+            }
+            else if (c >= 0x40 && c <= 0x7E)
+            {
+                m_state = States::Ground;
+                CsiDispatch(c);
+            }
+            else if (c == 0x1b)
+            {
+                m_state = States::Escape;
+            }
+            else if (c == 0x18 || c == 0x1a)
+            {
+                // CAN, SUB
+                m_state = States::Ground;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                Control(c);
+            }
+            // intermediate bytes are ignored
+            break;
+
+        case States::String:
+        {
+            // skip to BEL or ESC
+            auto q = p;
+            while (q < end && *q != 0x07 && *q != 0x1b)
+            {
+                ++q;
+            }
+            if (q < end)
+            {
+                m_state = *q == 0x07 ? States::Ground : States::StringEscape;
+                ++q;
+            }
+            p = q;
+            break;
+        }
+
+        case States::StringEscape:
+            ++p;
+            if (c == '\\')
+            {
+                m_state = States::Ground;
+            }
+            else
+            {
+                m_state = States::Ground;
+                Escape(c);
+            }
+            break;
+        }
+    }
+}
+
+// plain text that scrolls off before the next escape is never visible.
+// return bytes to skip
+size_t VtParser::SkipScrolledOut(const char *p, const char *end)
+{
+    auto &size = m_screen->size();
+    if (m_history || m_top != 0 || m_bottom != size.height - 1)
+    {
+        // the history keeps every line
+        return 0;
+    }
+    auto esc = (const char *)memchr(p, 0x1b, end - p);
+    if (!esc)
+    {
+        esc = end;
+    }
+    if ((size_t)(esc - p) < (size_t)size.width * size.height)
+    {
+        return 0;
+    }
+
+    // the last height lines are visible. skip to the LF before them
+    auto q = esc;
+    for (int i = 0; i < size.height; ++i)
+    {
+        q = (const char *)memrchr(p, '\n', q - p);
+        if (!q)
+        {
+            return 0;
+        }
+    }
+    if (q == p || q[-1] != '\r')
+    {
+        // column after LF is unknown
+        return 0;
+    }
+    // height LFs before it bring the cursor to the bottom row
+    auto r = q;
+    for (int i = 0; i < size.height; ++i)
+    {
+        r = (const char *)memrchr(p, '\n', r - p);
+        if (!r)
+        {
+            return 0;
+        }
+    }
+
+    m_screen->Scroll(0, size.height - 1, size.height, Blank());
+    m_x = 0;
+    m_y = size.height - 1;
+    m_wrapPending = false;
+    return q + 1 - p;
+}
+
+size_t VtParser::Ground(const char *p, const char *end)
+{
+    auto begin = p;
+    p += SkipScrolledOut(p, end);
+    while (p < end)
+    {
+        auto run = scan_printable(p, end);
+        if (run)
+        {
+            PrintAscii(p, run);
+            p += run;
+            continue;
+        }
+
+        auto c = (unsigned char)*p;
+        if (c == 0x1b)
+        {
+            ++p;
+            m_state = States::Escape;
+            break;
+        }
+        if (c < 0x20 || c == 0x7F)
+        {
+            Control(c);
+            ++p;
+            continue;
+        }
+
+        auto len = utf8_lead_length(c);
+        if (!len)
+        {
+            Print(replacement());
+            ++p;
+            continue;
+        }
+        if (end - p < len)
+        {
+            // wait next Feed
+            int i = 0;
+            for (; p + i < end && (i == 0 || (p[i] & 0xC0) == 0x80); ++i)
+            {
+                m_utf8[i] = p[i];
+            }
+            if (p + i < end)
+            {
+                Print(replacement());
+                p += i;
+                continue;
+            }
+            m_utf8Size = i;
+            p = end;
+            break;
+        }
+        int i = 1;
+        for (; i < len && (p[i] & 0xC0) == 0x80; ++i)
+        {
+        }
+        if (i < len)
+        {
+            Print(replacement());
+            p += i;
+            continue;
+        }
+        TermCodepoint cell{};
+        cell.cp = c8::utf8::codepoint((const char8_t *)p);
+        cell.cols = m_getCols(cell.cp.to_unicode());
+        Print(cell);
+        p += len;
+    }
+    return p - begin;
+}
+
+void VtParser::PrintAscii(const char *p, size_t size)
+{
+    auto &table = ascii_table();
+    auto width = m_screen->size().width;
+    auto blank = Blank();
+    auto flags = m_pen.flags;
+    auto fgcolor = m_pen.fgcolor;
+    auto bgcolor = m_pen.bgcolor;
+    while (size)
+    {
+        if (m_wrapPending && m_autoWrap)
+        {
+            m_x = 0;
+            LineFeed();
+        }
+        m_wrapPending = false;
+
+        auto row = m_screen->EditRow(m_y);
+        auto n = std::min(size, (size_t)(width - m_x));
+        if (m_x > 0 && row[m_x].cols == 0)
+        {
+            // right half of a wide char
+            row[m_x - 1] = blank;
+        }
+        // field by field from registers.
+        // copying a whole cell from the stack stalls store forwarding
+        auto dst = row.data() + m_x;
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[i].cp = table[(unsigned char)p[i]];
+            dst[i].cols = 1;
+            dst[i].flags = flags;
+            dst[i].fgcolor = fgcolor;
+            dst[i].bgcolor = bgcolor;
+        }
+        auto right = m_x + (int)n;
+        if (right < width && row[right].cols == 0)
+        {
+            row[right] = blank;
+        }
+
+        p += n;
+        size -= n;
+        m_x = right;
+        if (m_x >= width)
+        {
+            m_x = width - 1;
+            m_wrapPending = true;
+        }
+    }
+}
+
+void VtParser::Print(const TermCodepoint &src)
+{
+    if (src.cols <= 0)
+    {
+        // combining marks are not kept
+        return;
+    }
+    auto width = m_screen->size().width;
+    if (src.cols > width)
+    {
+        return;
+    }
+
+    if (m_wrapPending && m_autoWrap)
+    {
+        m_x = 0;
+        LineFeed();
+    }
+    m_wrapPending = false;
+    if (m_x + src.cols > width)
+    {
+        if (!m_autoWrap)
+        {
+            return;
+        }
+        // wide char does not fit at the end of line
+        EraseCells(m_y, m_x, width);
+        m_x = 0;
+        LineFeed();
+    }
+
+    auto blank = Blank();
+    auto row = m_screen->EditRow(m_y);
+    if (m_x > 0 && row[m_x].cols == 0)
+    {
+        row[m_x - 1] = blank;
+    }
+    auto cell = m_pen;
+    cell.cp = src.cp;
+    cell.cols = src.cols;
+    row[m_x] = cell;
+    cell.cols = 0;
+    for (int i = 1; i < src.cols; ++i)
+    {
+        // continuation
+        row[m_x + i] = cell;
+    }
+    auto right = m_x + src.cols;
+    if (right < width && row[right].cols == 0)
+    {
+        row[right] = blank;
+    }
+
+    m_x = right;
+    if (m_x >= width)
+    {
+        m_x = width - 1;
+        m_wrapPending = true;
+    }
+}
+
+void VtParser::Control(char c)
+{
+    switch (c)
+    {
+    case 0x08: // BS
+        if (m_x > 0)
+        {
+            --m_x;
+        }
+        m_wrapPending = false;
+        break;
+
+    case 0x09: // HT
+        m_x = std::min(m_screen->size().width - 1,
+                       (m_x / TAB_COLS + 1) * TAB_COLS);
+        break;
+
+    case 0x0A: // LF
+    case 0x0B: // VT
+    case 0x0C: // FF
+        LineFeed();
+        break;
+
+    case 0x0D: // CR
+        m_x = 0;
+        m_wrapPending = false;
+        break;
+
+    default:
+        // BEL, SO, SI...
+        break;
+    }
+}
+
+void VtParser::Escape(char c)
+{
+    switch (c)
+    {
+    case '[':
+        m_state = States::Csi;
+        m_params[0] = 0;
+        m_paramCount = 1;
+        m_private = 0;
+        break;
+
+    case ']': // OSC
+    case 'P': // DCS
+    case '_': // APC
+    case '^': // PM
+    case 'X': // SOS
+        m_state = States::String;
+        break;
+
+    case '(':
+    case ')':
+    case '*':
+    case '+':
+        m_state = States::Charset;
+        break;
+
+    case '7':
+        m_saved = {m_x, m_y, m_pen};
+        break;
+
+    case '8':
+        m_pen = m_saved.pen;
+        MoveTo(m_saved.x, m_saved.y);
+        break;
+
+    case 'D':
+        LineFeed();
+        break;
+
+    case 'E':
+        m_x = 0;
+        LineFeed();
+        break;
+
+    case 'M':
+        ReverseIndex();
+        break;
+
+    case 'c':
+        Reset();
+        break;
+
+    default:
+        // keypad mode and others
+        break;
+    }
+}
+
+// scroll the region up. lines leaving the top of the screen go to the history
+void VtParser::ScrollUp(int n)
+{
+    if (m_history && m_top == 0)
+    {
+        auto isBlank = [](const TermCodepoint &c) {
+            return c.cp.to_unicode() == ' ' && !c.flags &&
+                   c.fgcolor == TermColor{} && c.bgcolor == TermColor{};
+        };
+        for (int y = 0; y < std::min(n, m_bottom + 1); ++y)
+        {
+            auto &line = m_history->AppendLine();
+            m_screen->GetLine(y, line);
+            auto size = line.codes.size();
+            while (line.codes.size() && isBlank(line.codes.back()))
+            {
+                // trailing blanks would wrap to empty rows when narrower
+                line.codes.pop_back();
+            }
+            if (line.codes.size() != size)
+            {
+                line.Touch();
+            }
+        }
+    }
+    m_screen->Scroll(m_top, m_bottom, n, Blank());
+}
+
+void VtParser::LineFeed()
+{
+    m_wrapPending = false;
+    if (m_y == m_bottom)
+    {
+        ScrollUp(1);
+    }
+    else if (m_y < m_screen->size().height - 1)
+    {
+        ++m_y;
+    }
+}
+
+void VtParser::ReverseIndex()
+{
+    m_wrapPending = false;
+    if (m_y == m_top)
+    {
+        m_screen->Scroll(m_top, m_bottom, -1, Blank());
+    }
+    else if (m_y > 0)
+    {
+        --m_y;
+    }
+}
+
+void VtParser::EraseCells(int y, int begin, int end)
+{
+    auto width = m_screen->size().width;
+    begin = std::max(begin, 0);
+    end = std::min(end, width);
+    if (begin >= end)
+    {
+        return;
+    }
+    auto blank = Blank();
+    auto row = m_screen->EditRow(y);
+    if (begin > 0 && row[begin].cols == 0)
+    {
+        row[begin - 1] = blank;
+    }
+    if (end < width && row[end].cols == 0)
+    {
+        row[end] = blank;
+    }
+    FillCells(row.subspan(begin, end - begin), blank);
+}
+
+void VtParser::MoveTo(int x, int y)
+{
+    auto &size = m_screen->size();
+    m_x = std::clamp(x, 0, size.width - 1);
+    m_y = std::clamp(y, 0, size.height - 1);
+    m_wrapPending = false;
+}
+
+void VtParser::CsiDispatch(char final)
+{
+    auto &size = m_screen->size();
+    auto n = Param(0, 1);
+
+    if (m_private == '?')
+    {
+        if (final != 'h' && final != 'l')
+        {
+            return;
+        }
+        auto enable = final == 'h';
+        for (int i = 0; i < m_paramCount; ++i)
+        {
+            switch (m_params[i])
+            {
+            case 7:
+                m_autoWrap = enable;
+                break;
+            case 25:
+                m_cursorVisible = enable;
+                break;
+            case 47:
+            case 1047:
+            case 1049:
+                // no alternate buffer. start and end with a clean screen
+                if (enable)
+                {
+                    m_saved = {m_x, m_y, m_pen};
+                }
+                for (int y = 0; y < size.height; ++y)
+                {
+                    EraseCells(y, 0, size.width);
+                }
+                if (!enable)
+                {
+                    m_pen = m_saved.pen;
+                    MoveTo(m_saved.x, m_saved.y);
+                }
+                break;
+            }
+        }
+        return;
+    }
+    if (m_private)
+    {
+        if (m_private == '>' && final == 'c')
+        {
+            m_reply.append("\033[>0;0;0c");
+        }
+        return;
+    }
+
+    switch (final)
+    {
+    case '@': // ICH
+    {
+        n = std::min(n, size.width - m_x);
+        auto row = m_screen->EditRow(m_y);
+        std::copy_backward(row.begin() + m_x, row.end() - n, row.end());
+        EraseCells(m_y, m_x, m_x + n);
+        break;
+    }
+
+    case 'P': // DCH
+    {
+        n = std::min(n, size.width - m_x);
+        auto row = m_screen->EditRow(m_y);
+        std::copy(row.begin() + m_x + n, row.end(), row.begin() + m_x);
+        EraseCells(m_y, size.width - n, size.width);
+        break;
+    }
+
+    case 'X': // ECH
+        EraseCells(m_y, m_x, m_x + n);
+        break;
+
+    case 'A':
+        MoveTo(m_x, m_y - n);
+        break;
+
+    case 'B':
+    case 'e':
+        MoveTo(m_x, m_y + n);
+        break;
+
+    case 'C':
+    case 'a':
+        MoveTo(m_x + n, m_y);
+        break;
+
+    case 'D':
+        MoveTo(m_x - n, m_y);
+        break;
+
+    case 'E':
+        MoveTo(0, m_y + n);
+        break;
+
+    case 'F':
+        MoveTo(0, m_y - n);
+        break;
+
+    case 'G':
+    case '`':
+        MoveTo(n - 1, m_y);
+        break;
+
+    case 'd':
+        MoveTo(m_x, n - 1);
+        break;
+
+    case 'H':
+    case 'f':
+        MoveTo(Param(1, 1) - 1, Param(0, 1) - 1);
+        break;
+
+    case 'J':
+        switch (Param(0, 0))
+        {
+        case 0:
+            EraseCells(m_y, m_x, size.width);
+            for (int y = m_y + 1; y < size.height; ++y)
+            {
+                EraseCells(y, 0, size.width);
+            }
+            break;
+        case 1:
+            for (int y = 0; y < m_y; ++y)
+            {
+                EraseCells(y, 0, size.width);
+            }
+            EraseCells(m_y, 0, m_x + 1);
+            break;
+        default:
+            for (int y = 0; y < size.height; ++y)
+            {
+                EraseCells(y, 0, size.width);
+            }
+            break;
+        }
+        break;
+
+    case 'K':
+        switch (Param(0, 0))
+        {
+        case 0:
+            EraseCells(m_y, m_x, size.width);
+            break;
+        case 1:
+            EraseCells(m_y, 0, m_x + 1);
+            break;
+        default:
+            EraseCells(m_y, 0, size.width);
+            break;
+        }
+        break;
+
+    case 'L': // IL
+        if (m_y >= m_top && m_y <= m_bottom)
+        {
+            m_screen->Scroll(m_y, m_bottom, -n, Blank());
+            m_x = 0;
+        }
+        break;
+
+    case 'M': // DL
+        if (m_y >= m_top && m_y <= m_bottom)
+        {
+            m_screen->Scroll(m_y, m_bottom, n, Blank());
+            m_x = 0;
+        }
+        break;
+
+    case 'S':
+        ScrollUp(n);
+        break;
+
+    case 'T':
+        m_screen->Scroll(m_top, m_bottom, -n, Blank());
+        break;
+
+    case 'm':
+        Sgr();
+        break;
+
+    case 'r': // DECSTBM
+    {
+        auto top = Param(0, 1) - 1;
+        auto bottom = Param(1, size.height) - 1;
+        if (top < bottom && bottom < size.height)
+        {
+            m_top = top;
+            m_bottom = bottom;
+        }
+        MoveTo(0, 0);
+        break;
+    }
+
+    case 's':
+        m_saved = {m_x, m_y, m_pen};
+        break;
+
+    case 'u':
+        m_pen = m_saved.pen;
+        MoveTo(m_saved.x, m_saved.y);
+        break;
+
+    case 'n': // DSR
+        if (Param(0, 0) == 6)
+        {
+            m_reply.append("\033[" + std::to_string(m_y + 1) + ";" +
+                           std::to_string(m_x + 1) + "R");
+        }
+        else if (Param(0, 0) == 5)
+        {
+            m_reply.append("\033[0n");
+        }
+        break;
+
+    case 'c': // DA
+        m_reply.append("\033[?1;2c");
+        break;
+    }
+}
+
+void VtParser::Sgr()
+{
+    for (int i = 0; i < m_paramCount; ++i)
+    {
+        auto p = m_params[i];
+        switch (p)
+        {
+        case 0:
+            m_pen.flags = 0;
+            m_pen.fgcolor = {};
+            m_pen.bgcolor = {};
+            break;
+        case 1:
+            m_pen.flags |= (int)TermFlags::Bold;
+            break;
+        case 4:
+            m_pen.flags |= (int)TermFlags::Underline;
+            break;
+        case 7:
+            m_pen.flags |= (int)TermFlags::Standout;
+            break;
+        case 22:
+            m_pen.flags &= ~(int)TermFlags::Bold;
+            break;
+        case 24:
+            m_pen.flags &= ~(int)TermFlags::Underline;
+            break;
+        case 27:
+            m_pen.flags &= ~(int)TermFlags::Standout;
+            break;
+        case 39:
+            m_pen.fgcolor = {};
+            break;
+        case 49:
+            m_pen.bgcolor = {};
+            break;
+        case 38:
+        case 48:
+        {
+            auto &color = p == 38 ? m_pen.fgcolor : m_pen.bgcolor;
+            if (i + 2 < m_paramCount && m_params[i + 1] == 5)
+            {
+                color = {(uint8_t)m_params[i + 2], 0, 0,
+                         TermColorTypes::Color256};
+                i += 2;
+            }
+            else if (i + 4 < m_paramCount && m_params[i + 1] == 2)
+            {
+                color = {(uint8_t)m_params[i + 2], (uint8_t)m_params[i + 3],
+                         (uint8_t)m_params[i + 4], TermColorTypes::Color24bit};
+                i += 4;
+            }
+            break;
+        }
+        default:
+            if (p >= 30 && p <= 37)
+            {
+                m_pen.fgcolor = {(uint8_t)(p - 30), 0, 0, TermColorTypes::Ansi};
+            }
+            else if (p >= 40 && p <= 47)
+            {
+                m_pen.bgcolor = {(uint8_t)(p - 40), 0, 0, TermColorTypes::Ansi};
+            }
+            else if (p >= 90 && p <= 97)
+            {
+                // bright
+                m_pen.fgcolor = {(uint8_t)(p - 90 + 8), 0, 0,
+                                 TermColorTypes::Ansi};
+            }
+            else if (p >= 100 && p <= 107)
+            {
+                m_pen.bgcolor = {(uint8_t)(p - 100 + 8), 0, 0,
+                                 TermColorTypes::Ansi};
+            }
+            break;
+        }
+    }
+}
+
+} // namespace termgrid
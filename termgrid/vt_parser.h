@@ -0,0 +1,122 @@
+#pragma once
+#include "screen.h"
+#include "scrollback.h"
+#include <string>
+#include <string_view>
+
+namespace termgrid
+{
+
+/// 子 process の出力 (VT100/xterm の subset) を TermScreen に書く。
+///
+/// 表示可能な ascii の連続は SIMD で探してまとめて cell に書き、
+/// escape と制御文字のところだけ state machine に落ちる。
+/// 消去と scroll は現在の背景色で埋める。
+/// history があれば、画面の上端から scroll で出た行をそこに追加する。
+class VtParser
+{
+    enum class States
+    {
+        Ground,
+        Escape,
+        // ESC ( etc. skip 1 byte
+        Charset,
+        Csi,
+        // OSC, DCS, APC... ignored until BEL or ST
+        String,
+        StringEscape,
+    };
+
+    TermScreen *m_screen;
+    TermLine::GetColsFunc m_getCols;
+    // not owned
+    Scrollback *m_history = nullptr;
+    States m_state = States::Ground;
+
+    // incomplete utf-8 across Feed
+    char m_utf8[4];
+    int m_utf8Size = 0;
+
+    static const int MAX_PARAMS = 16;
+    int m_params[MAX_PARAMS];
+    int m_paramCount = 0;
+    // '?', '>' ...
+    char m_private = 0;
+
+    // current attributes. cp and cols unused
+    TermCodepoint m_pen;
+    int m_x = 0;
+    int m_y = 0;
+    // written at the last column. wrap before the next char
+    bool m_wrapPending = false;
+    int m_top = 0;
+    int m_bottom = 0;
+    bool m_autoWrap = true;
+    bool m_cursorVisible = true;
+
+    struct
+    {
+        int x;
+        int y;
+        TermCodepoint pen;
+    } m_saved;
+
+    // answers to queries (DSR, DA). write to the child
+    std::string m_reply;
+
+public:
+    VtParser(TermScreen &screen, const TermLine::GetColsFunc &getCols);
+
+    void Feed(std::string_view data);
+
+    // lines scrolled off the top go here. nullptr to stop
+    void SetHistory(Scrollback *history)
+    {
+        m_history = history;
+    }
+
+    // after screen Resize
+    void Resize();
+    void Reset();
+
+    TermPoint cursor() const
+    {
+        return {m_x, m_y};
+    }
+
+    bool IsCursorVisible() const
+    {
+        return m_cursorVisible;
+    }
+
+    // take pending reply
+    void TakeReply(std::string &out)
+    {
+        out.append(m_reply);
+        m_reply.clear();
+    }
+
+private:
+    size_t Ground(const char *p, const char *end);
+    size_t SkipScrolledOut(const char *p, const char *end);
+    void PrintAscii(const char *p, size_t size);
+    void Print(const TermCodepoint &cell);
+    void Control(char c);
+    void Escape(char c);
+    void CsiDispatch(char final);
+    void Sgr();
+
+    int Param(int i, int defaultValue) const
+    {
+        return i < m_paramCount && m_params[i] > 0 ? m_params[i] : defaultValue;
+    }
+
+    TermCodepoint Blank() const;
+    void ScrollUp(int n);
+    void LineFeed();
+    void ReverseIndex();
+    void EraseCells(int y, int begin, int end);
+    void MoveTo(int x, int y);
+};
+
+} // namespace termgrid
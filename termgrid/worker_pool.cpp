@@ -0,0 +1,87 @@
+#include "worker_pool.h"
+#include "trace.h"
+
+namespace termgrid
+{
+
+WorkerPool::WorkerPool(int threads)
+{
+    if (threads <= 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    for (int i = 1; i < threads; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::Loop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_start.notify_all();
+    for (auto &t : m_threads)
+    {
+        t.join();
+    }
+}
+
+void WorkerPool::Run(const std::function<void(int worker)> &task)
+{
+    if (m_threads.empty())
+    {
+        task(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_running = (int)m_threads.size();
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_running == 0; });
+    m_task = nullptr;
+}
+
+void WorkerPool::Loop(int worker)
+{
+    TERMGRID_TRACE_THREAD_NAME("worker");
+    uint64_t generation = 0;
+    while (true)
+    {
+        const std::function<void(int)> *task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, generation] {
+                return m_quit || m_generation != generation;
+            });
+            if (m_quit)
+            {
+                return;
+            }
+            generation = m_generation;
+            task = m_task;
+        }
+
+        (*task)(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_running == 0)
+            {
+                m_done.notify_one();
+            }
+        }
+    }
+}
+
+} // namespace termgrid
@@ -0,0 +1,43 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace termgrid
+{
+
+/// 固定数の worker thread。
+/// Run は呼び出しスレッドを worker 0 として全 worker で task を 1 回ずつ実行し、
+/// 全部終わるまで待つ。
+class WorkerPool
+{
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(int)> *m_task = nullptr;
+    uint64_t m_generation = 0;
+    int m_running = 0;
+    bool m_quit = false;
+
+public:
+    // threads <= 0: hardware_concurrency
+    WorkerPool(int threads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const
+    {
+        return (int)m_threads.size() + 1;
+    }
+
+    void Run(const std::function<void(int worker)> &task);
+
+private:
+    void Loop(int worker);
+};
+
+} // namespace termgrid